@@ -0,0 +1,234 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+// 序列化性能测试的公共部分：测试数据、计时与输出 =>
+// 每个后端(dspacket/simplemarshal/jsonmarshal)各自编译为独立的程序，
+// dspacket.h与simplemarshal.h定义了同名的Marshallable与Object2String等，不能链接到同一个程序中
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+
+// 由bench_main.cpp中替换的operator new计数，不包括缓冲区直接经malloc/mmap/内存池的分配
+uint64_t bench_alloc_count();
+
+// 命令行给出的过滤串，为空时全部运行
+bool bench_selected(const char * pBackend, const char * pShape);
+
+// 防止被测代码的结果被编译器优化掉
+inline void bench_keep(size_t n)
+{
+    static volatile size_t s_nSink;
+    s_nSink = n;
+    (void)s_nSink;
+}
+
+// 测试数据 =>
+
+// 标量为主的结构
+struct BScalar
+{
+    bool b;
+    uint8_t u8;
+    int8_t i8;
+    uint16_t u16;
+    int16_t i16;
+    uint32_t u32a, u32b, u32c, u32d;
+    int32_t i32a, i32b, i32c;
+};
+#define BENCH_SCALAR_FIELDS(X) X(b) X(u8) X(i8) X(u16) X(i16) X(u32a) X(u32b) X(u32c) X(u32d) X(i32a) X(i32b) X(i32c)
+
+// 字符串为主的结构
+struct BStrings
+{
+    std::string s1, s2, s3, s4, s5, s6;
+};
+#define BENCH_STRINGS_FIELDS(X) X(s1) X(s2) X(s3) X(s4) X(s5) X(s6)
+
+// 大整数数组
+struct BIntVec
+{
+    std::vector<uint32_t> v;
+};
+#define BENCH_INTVEC_FIELDS(X) X(v)
+
+// 浮点数组，如监控数据
+struct BDoubles
+{
+    std::vector<double> v;
+};
+#define BENCH_DOUBLES_FIELDS(X) X(v)
+
+// 嵌套的map
+struct BNested
+{
+    std::map<std::string, std::map<std::string, uint32_t> > m;
+};
+#define BENCH_NESTED_FIELDS(X) X(m)
+
+// 很小的消息
+struct BTiny
+{
+    uint32_t id;
+    uint16_t type;
+};
+#define BENCH_TINY_FIELDS(X) X(id) X(type)
+
+inline void bench_fill(BScalar & o)
+{
+    o.b = true; o.u8 = 200; o.i8 = -100; o.u16 = 60000; o.i16 = -30000;
+    o.u32a = 1; o.u32b = 300; o.u32c = 70000; o.u32d = 4000000000u;
+    o.i32a = -1; o.i32b = 123456; o.i32c = -2000000000;
+}
+
+inline void bench_fill(BStrings & o)
+{
+    o.s1.assign(8, 'a'); o.s2.assign(16, 'b'); o.s3.assign(32, 'c');
+    o.s4.assign(64, 'd'); o.s5.assign(128, 'e'); o.s6.assign(256, 'f');
+}
+
+inline void bench_fill(BIntVec & o)
+{
+    o.v.resize(64 * 1024);
+    for (size_t i = 0; i < o.v.size(); ++i)
+        o.v[i] = uint32_t(i * 2654435761u);
+}
+
+inline void bench_fill(BDoubles & o)
+{
+    o.v.resize(16 * 1024);
+    for (size_t i = 0; i < o.v.size(); ++i)
+        o.v[i] = double(i) * 0.731 + 1.0 / double(i + 3);
+}
+
+inline void bench_fill(BNested & o)
+{
+    char szKey[32];
+    for (int i = 0; i < 20; ++i)
+    {
+        snprintf(szKey, sizeof(szKey), "outer_%d", i);
+        std::map<std::string, uint32_t> & m = o.m[szKey];
+        for (int j = 0; j < 20; ++j)
+        {
+            snprintf(szKey, sizeof(szKey), "inner_%d", j);
+            m[szKey] = uint32_t(i * 100 + j);
+        }
+    }
+}
+
+inline void bench_fill(BTiny & o)
+{
+    o.id = 12345;
+    o.type = 7;
+}
+
+// 计时与输出 =>
+
+inline void bench_header()
+{
+    printf("backend,shape,op,bytes,iters,ns_per_op,msgs_per_s,mb_per_s,new_per_op,p50_ns,p99_ns\n");
+}
+
+// 输出一行结果，vecNs为逐次计时的样本
+inline void bench_report(const char * pBackend, const char * pShape, const char * pOp, size_t nBytes,
+                         uint64_t nIters, double dSeconds, uint64_t nAllocs, std::vector<double> & vecNs)
+{
+    std::sort(vecNs.begin(), vecNs.end());
+    size_t nSamples = vecNs.size();
+
+    double dNsPerOp = dSeconds * 1e9 / nIters;
+    printf("%s,%s,%s,%zu,%llu,%.1f,%.0f,%.1f,%.2f,%.0f,%.0f\n",
+           pBackend, pShape, pOp, nBytes, (unsigned long long)nIters,
+           dNsPerOp, 1e9 / dNsPerOp, nBytes * 1e3 / dNsPerOp, double(nAllocs) / nIters,
+           vecNs[nSamples / 2], vecNs[nSamples * 99 / 100]);
+    fflush(stdout);
+}
+
+// 先预热并校准迭代次数，整体计时得到吞吐与每次的分配次数，再逐次计时得到p50/p99；
+// 逐次计时包含约20ns的时钟开销，只用于比较延迟分布
+template <typename Func>
+inline void bench_run(const char * pBackend, const char * pShape, const char * pOp, size_t nBytes, const Func & func)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    for (int i = 0; i < 3; ++i)
+        func();
+
+    // 校准到约0.2秒
+    uint64_t nIters = 1;
+    double dSeconds = 0;
+    for (;;)
+    {
+        Clock::time_point t0 = Clock::now();
+        for (uint64_t i = 0; i < nIters; ++i)
+            func();
+        dSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (dSeconds >= 0.05 || nIters >= (uint64_t(1) << 30))
+            break;
+        nIters *= 4;
+    }
+    nIters = uint64_t(nIters * (0.2 / (dSeconds > 1e-9 ? dSeconds : 1e-9)));
+    if (nIters == 0)
+        nIters = 1;
+
+    uint64_t nAllocs = bench_alloc_count();
+    Clock::time_point t0 = Clock::now();
+    for (uint64_t i = 0; i < nIters; ++i)
+        func();
+    dSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    nAllocs = bench_alloc_count() - nAllocs;
+
+    size_t nSamples = size_t(nIters < 20000 ? nIters : 20000);
+    std::vector<double> vecNs(nSamples);
+    for (size_t i = 0; i < nSamples; ++i)
+    {
+        Clock::time_point t1 = Clock::now();
+        func();
+        vecNs[i] = std::chrono::duration<double, std::nano>(Clock::now() - t1).count();
+    }
+
+    bench_report(pBackend, pShape, pOp, nBytes, nIters, dSeconds, nAllocs, vecNs);
+}
+
+// 单次耗时较长(如压包到1G)的测试项：先运行一次，按其耗时定出合计约0.25秒的次数(最多256次)，
+// 逐次计时并直接汇总，不再单独测吞吐
+template <typename Func>
+inline void bench_run_long(const char * pBackend, const char * pShape, const char * pOp, size_t nBytes, const Func & func)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point t0 = Clock::now();
+    func();
+    double dFirst = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    uint64_t nIters = uint64_t(0.25 / (dFirst > 1e-6 ? dFirst : 1e-6));
+    if (nIters < 1)
+        nIters = 1;
+    if (nIters > 256)
+        nIters = 256;
+
+    size_t nSamples = size_t(nIters);
+    std::vector<double> vecNs(nSamples);
+    double dSeconds = 0;
+    uint64_t nAllocs = bench_alloc_count();
+    for (size_t i = 0; i < nSamples; ++i)
+    {
+        Clock::time_point t1 = Clock::now();
+        func();
+        vecNs[i] = std::chrono::duration<double, std::nano>(Clock::now() - t1).count();
+        dSeconds += vecNs[i] / 1e9;
+    }
+    nAllocs = bench_alloc_count() - nAllocs;
+
+    bench_report(pBackend, pShape, pOp, nBytes, nIters, dSeconds, nAllocs, vecNs);
+}
+
+// 后端的入口，每个后端的程序各自实现
+void bench_backend();
+
+#endif // __BENCH_H__
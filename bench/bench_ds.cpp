@@ -0,0 +1,374 @@
+// dspacket后端，另外测试紧凑模式、畸形数据的拒绝、并行解码与并行压包的线程扩展 =>
+
+#include <stdlib.h>
+#include <thread>
+#include <type_traits>
+
+#include "dspacket.h"
+#include "dsparallel.h"
+
+#include "bench.h"
+
+using namespace dakuang;
+
+#define DS_PUT(f) p << f;
+#define DS_GET(f) up >> f;
+
+#define DS_BENCH_STRUCT(Name, Base, FIELDS) \
+    struct Name : public Base, public Marshallable \
+    { \
+        virtual void marshal(DSPack & p) const { FIELDS(DS_PUT) } \
+        virtual void unmarshal(const DSUnpack & up) { FIELDS(DS_GET) } \
+    };
+
+DS_BENCH_STRUCT(DSScalar, BScalar, BENCH_SCALAR_FIELDS)
+DS_BENCH_STRUCT(DSStrings, BStrings, BENCH_STRINGS_FIELDS)
+DS_BENCH_STRUCT(DSIntVec, BIntVec, BENCH_INTVEC_FIELDS)
+DS_BENCH_STRUCT(DSDoubles, BDoubles, BENCH_DOUBLES_FIELDS)
+DS_BENCH_STRUCT(DSNested, BNested, BENCH_NESTED_FIELDS)
+DS_BENCH_STRUCT(DSTiny, BTiny, BENCH_TINY_FIELDS)
+
+template <typename T>
+static void run_ds(const char * pShape)
+{
+    if (!bench_selected("ds", pShape))
+        return;
+
+    T obj;
+    bench_fill(obj);
+
+    std::string str;
+    Object2String(obj, str);
+
+    bench_run("ds", pShape, "pack", str.size(), [&]()
+    {
+        std::string s;
+        Object2String(obj, s);
+        bench_keep(s.size());
+    });
+    bench_run("ds", pShape, "unpack", str.size(), [&]()
+    {
+        T o;
+        bench_keep(String2Object(str, o));
+    });
+}
+
+template <typename T>
+static void run_ds_compact(const char * pShape)
+{
+    if (!bench_selected("ds-compact", pShape))
+        return;
+
+    T obj;
+    bench_fill(obj);
+
+    DSPackBuffer buffer;
+    DSPack pack(buffer);
+    pack.set_compact(true);
+    pack << obj;
+    std::string str(pack.data(), pack.size());
+
+    bench_run("ds-compact", pShape, "pack", str.size(), [&]()
+    {
+        DSPackBuffer b;
+        DSPack p(b);
+        p.set_compact(true);
+        p << obj;
+        bench_keep(p.size());
+    });
+    bench_run("ds-compact", pShape, "unpack", str.size(), [&]()
+    {
+        T o;
+        DSUnpack up(str.data(), str.size());
+        up.set_compact(true);
+        up.set_nothrow(true);
+        up >> o;
+        bench_keep(up.ok());
+    });
+}
+
+// 并行压包10万条记录，线程数从1到硬件线程数按2倍递增；先检查输出与逐个序列化逐字节相同
+struct DSScalarBatch : public Marshallable
+{
+    std::vector<DSScalar> v;
+    size_t nThreads;
+
+    DSScalarBatch() : nThreads(0) {}
+
+    virtual void marshal(DSPack & p) const
+    {
+        if (nThreads == 0)
+            marshal_container(p, v);
+        else
+            marshal_container_parallel(p, v, nThreads);
+    }
+    virtual void unmarshal(const DSUnpack & up) { up >> v; }
+};
+
+static void run_ds_parallel_pack()
+{
+    if (!bench_selected("ds-parallel-pack", "scalar_batch"))
+        return;
+
+    DSScalarBatch batch;
+    batch.v.resize(100000);
+    for (size_t i = 0; i < batch.v.size(); ++i)
+    {
+        bench_fill(batch.v[i]);
+        batch.v[i].u32a = uint32_t(i);
+    }
+
+    std::string strExpect;
+    Object2String(batch, strExpect);
+
+    size_t nMaxThreads = DSHardwareThreads();
+    for (size_t nThreads = 1; ; nThreads *= 2)
+    {
+        if (nThreads > nMaxThreads)
+            nThreads = nMaxThreads;
+
+        batch.nThreads = nThreads;
+
+        std::string str;
+        Object2String(batch, str);
+        if (str != strExpect)
+        {
+            fprintf(stderr, "ds-parallel-pack-%zut: output differs from marshal_container()\n", nThreads);
+            exit(1);
+        }
+
+        char szBackend[32];
+        snprintf(szBackend, sizeof(szBackend), "ds-parallel-pack-%zut", nThreads);
+        bench_run(szBackend, "scalar_batch", "pack", str.size(), [&]()
+        {
+            std::string s;
+            Object2String(batch, s);
+            bench_keep(s.size());
+        });
+
+        if (nThreads == nMaxThreads)
+            break;
+    }
+}
+
+// 压包缓冲区的增长：逐个压入uint32直到1M...1G，线性扩容时每字节耗时不随大小变化 =>
+// ds-grow-packbuffer为DSPackBuffer，扩容策略由编译时的DS_PACKBUFFER_GROWTH_POLICY决定；
+// 其余各行为同样最大1G的DSBuffer换用不同的分配器与扩容策略：new不支持ordered_realloc，扩容时分配新块并复制，
+// realloc与mremap原地扩容；GROWTH_EXACT加复制为平方复杂度，只测到4M
+
+#define BENCH_STR(x) BENCH_STR_(x)
+#define BENCH_STR_(x) #x
+
+template <typename BlockAllocator, typename GrowthPolicy>
+class BenchGrowSink
+        : public DSPackSink
+{
+private:
+    DSBuffer<BlockAllocator, 1024 * 256, GrowthPolicy> m_buffer;
+
+public:
+    virtual const char * data() const { return m_buffer.data(); }
+    virtual size_t size() const { return m_buffer.size(); }
+
+    virtual void resize(size_t nSize)
+    {
+        if (!m_buffer.resize(nSize))
+            throw DSError("[BenchGrowSink::resize] resize buffer overflow");
+    }
+    virtual void append(const char * pData, size_t nSize)
+    {
+        if (!m_buffer.append(pData, nSize))
+            throw DSError("[BenchGrowSink::append] append buffer overflow");
+    }
+    virtual void replace(size_t nPos, const char * pData, size_t nSize)
+    {
+        if (!m_buffer.replace(nPos, pData, nSize))
+            throw DSError("[BenchGrowSink::replace] replace buffer overflow");
+    }
+};
+
+static void bench_grow_pack(DSPack & p, size_t nBytes)
+{
+    for (size_t i = 0; i < nBytes / 4; ++i)
+        p.push_uint32(uint32_t(i));
+}
+
+static const size_t s_arrGrowSize[] = { 1u << 20, 4u << 20, 16u << 20, 64u << 20, 256u << 20, 1u << 30 };
+static const char * const s_arrGrowShape[] = { "1M", "4M", "16M", "64M", "256M", "1G" };
+
+static void run_ds_grow_packbuffer()
+{
+    const char * pBackend = "ds-grow-packbuffer-" BENCH_STR(DS_PACKBUFFER_GROWTH_POLICY);
+    size_t nMaxBytes = (std::is_same<DS_PACKBUFFER_GROWTH_POLICY, GROWTH_EXACT>::value ? 4u << 20 : size_t(-1));
+    for (size_t i = 0; i < sizeof(s_arrGrowSize) / sizeof(s_arrGrowSize[0]); ++i)
+    {
+        size_t nBytes = s_arrGrowSize[i];
+        if (nBytes > nMaxBytes || !bench_selected(pBackend, s_arrGrowShape[i]))
+            continue;
+
+        bench_run_long(pBackend, s_arrGrowShape[i], "pack", nBytes, [&]()
+        {
+            DSPackBuffer buffer;
+            DSPack p(buffer);
+            bench_grow_pack(p, nBytes);
+            bench_keep(p.size());
+        });
+    }
+}
+
+template <typename BlockAllocator, typename GrowthPolicy>
+static void run_ds_grow(const char * pBackend, size_t nMaxBytes = size_t(-1))
+{
+    for (size_t i = 0; i < sizeof(s_arrGrowSize) / sizeof(s_arrGrowSize[0]); ++i)
+    {
+        size_t nBytes = s_arrGrowSize[i];
+        if (nBytes > nMaxBytes || !bench_selected(pBackend, s_arrGrowShape[i]))
+            continue;
+
+        bench_run_long(pBackend, s_arrGrowShape[i], "pack", nBytes, [&]()
+        {
+            BenchGrowSink<BlockAllocator, GrowthPolicy> sink;
+            DSPack p(sink);
+            bench_grow_pack(p, nBytes);
+            bench_keep(p.size());
+        });
+    }
+}
+
+static void run_ds_grow_all()
+{
+    typedef SBlockAllocator_MallocFree<4 * 1024> BLOCK_ALLOC_REALLOC_4K;
+
+    run_ds_grow_packbuffer();
+
+    run_ds_grow<BLOCK_ALLOC_4K, GROWTH_2X>("ds-grow-new-GROWTH_2X");
+    run_ds_grow<BLOCK_ALLOC_4K, GROWTH_1_5X>("ds-grow-new-GROWTH_1_5X");
+    run_ds_grow<BLOCK_ALLOC_4K, GROWTH_CAPPED_2X>("ds-grow-new-GROWTH_CAPPED_2X");
+    run_ds_grow<BLOCK_ALLOC_4K, GROWTH_EXACT>("ds-grow-new-GROWTH_EXACT", 4u << 20);
+
+    run_ds_grow<BLOCK_ALLOC_REALLOC_4K, GROWTH_2X>("ds-grow-realloc-GROWTH_2X");
+    run_ds_grow<BLOCK_ALLOC_REALLOC_4K, GROWTH_1_5X>("ds-grow-realloc-GROWTH_1_5X");
+    run_ds_grow<BLOCK_ALLOC_REALLOC_4K, GROWTH_CAPPED_2X>("ds-grow-realloc-GROWTH_CAPPED_2X");
+    run_ds_grow<BLOCK_ALLOC_REALLOC_4K, GROWTH_EXACT>("ds-grow-realloc-GROWTH_EXACT");
+
+    run_ds_grow<BLOCK_ALLOC_MMAP, GROWTH_2X>("ds-grow-mremap-GROWTH_2X");
+    run_ds_grow<BLOCK_ALLOC_MMAP, GROWTH_1_5X>("ds-grow-mremap-GROWTH_1_5X");
+    run_ds_grow<BLOCK_ALLOC_MMAP, GROWTH_CAPPED_2X>("ds-grow-mremap-GROWTH_CAPPED_2X");
+    run_ds_grow<BLOCK_ALLOC_MMAP, GROWTH_EXACT>("ds-grow-mremap-GROWTH_EXACT");
+}
+
+// 拒绝畸形数据的吞吐：截断的或字符串长度前缀被改大的DSStrings包，
+// 分别经String2Object()(抛异常)与String2ObjectNoThrow()解包，计时前先确认全部被拒绝
+static void run_ds_reject_one(const char * pShape, const std::vector<std::string> & vecBad, size_t nBytes)
+{
+    for (size_t i = 0; i < vecBad.size(); ++i)
+    {
+        DSStrings o1, o2;
+        if (String2Object(vecBad[i], o1) || String2ObjectNoThrow(vecBad[i], o2))
+        {
+            fprintf(stderr, "ds-reject/%s: malformed packet %zu accepted\n", pShape, i);
+            exit(1);
+        }
+    }
+
+    size_t n = 0;
+    bench_run("ds-reject", pShape, "unpack-throw", nBytes, [&]()
+    {
+        DSStrings o;
+        bench_keep(String2Object(vecBad[n++ % vecBad.size()], o));
+    });
+    bench_run("ds-reject", pShape, "unpack-nothrow", nBytes, [&]()
+    {
+        DSStrings o;
+        bench_keep(String2ObjectNoThrow(vecBad[n++ % vecBad.size()], o));
+    });
+}
+
+static void run_ds_reject()
+{
+    DSStrings obj;
+    bench_fill(obj);
+
+    std::string str;
+    Object2String(obj, str);
+
+    // 在最后一个字节之前的64个位置截断
+    if (bench_selected("ds-reject", "truncated"))
+    {
+        std::vector<std::string> vecBad;
+        for (size_t i = 0; i < 64; ++i)
+            vecBad.push_back(str.substr(0, (str.size() - 1) * i / 64));
+
+        run_ds_reject_one("truncated", vecBad, str.size());
+    }
+
+    // 依次把每个字符串的长度前缀改为0xFFFF
+    if (bench_selected("ds-reject", "corrupted"))
+    {
+        const std::string * arrField[] = { &obj.s1, &obj.s2, &obj.s3, &obj.s4, &obj.s5, &obj.s6 };
+        std::vector<std::string> vecBad;
+        size_t nPos = 0;
+        for (size_t i = 0; i < sizeof(arrField) / sizeof(arrField[0]); ++i)
+        {
+            std::string s(str);
+            s[nPos] = s[nPos + 1] = char(0xFF);
+            vecBad.push_back(s);
+            nPos += 2 + arrField[i]->size();
+        }
+
+        run_ds_reject_one("corrupted", vecBad, str.size());
+    }
+}
+
+// 并行解码10万条记录，线程数从1到硬件线程数按2倍递增
+static void run_ds_parallel()
+{
+    if (!bench_selected("ds-parallel", "scalar_batch"))
+        return;
+
+    DSScalar obj;
+    bench_fill(obj);
+
+    DSPackBuffer buffer;
+    for (int i = 0; i < 100000; ++i)
+        Object2Frame(obj, buffer);
+
+    size_t nMaxThreads = DSHardwareThreads();
+    for (size_t nThreads = 1; ; nThreads *= 2)
+    {
+        if (nThreads > nMaxThreads)
+            nThreads = nMaxThreads;
+
+        char szBackend[32];
+        snprintf(szBackend, sizeof(szBackend), "ds-parallel-%zut", nThreads);
+        bench_run(szBackend, "scalar_batch", "unpack", buffer.size(), [&]()
+        {
+            std::vector<DSScalar> vecOut;
+            bench_keep(DSParallelDecode(buffer.data(), buffer.size(), vecOut, nThreads));
+        });
+
+        if (nThreads == nMaxThreads)
+            break;
+    }
+}
+
+void bench_backend()
+{
+    run_ds<DSScalar>("scalar");
+    run_ds<DSStrings>("strings");
+    run_ds<DSIntVec>("intvec");
+    run_ds<DSDoubles>("doubles");
+    run_ds<DSNested>("nested");
+    run_ds<DSTiny>("tiny");
+
+    run_ds_compact<DSScalar>("scalar");
+    run_ds_compact<DSIntVec>("intvec");
+    run_ds_compact<DSTiny>("tiny");
+
+    run_ds_reject();
+
+    run_ds_parallel();
+    run_ds_parallel_pack();
+
+    run_ds_grow_all();
+}
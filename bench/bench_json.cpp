@@ -0,0 +1,98 @@
+// jsonmarshal后端，序列化为紧凑的json字符串；json-stream为不经过Json::Value的流式输出与读取 =>
+
+#include "jsonmarshal/jsonmarshal.h"
+
+#include "bench.h"
+
+using namespace dakuang;
+
+#define JSON_PUT(f) js[#f] << f;
+#define JSON_GET(f) js[#f] >> f;
+#define JSON_WRITE(f) w[#f] << f;
+#define JSON_READ(f) JSON_READ_FIELD(#f, f)
+
+#define JSON_BENCH_STRUCT(Name, Base, FIELDS) \
+    struct Name : public Base, public JsonMarshallable \
+    { \
+        virtual void marshal(Json::Value & js) const { FIELDS(JSON_PUT) } \
+        virtual void marshal_stream(JsonWriter & w) const { FIELDS(JSON_WRITE) } \
+        virtual void unmarshal(const Json::Value & js) { FIELDS(JSON_GET) } \
+        virtual void unmarshal_stream(JsonReader & r) \
+        { \
+            JSON_READ_BEGIN(r) \
+                FIELDS(JSON_READ) \
+            JSON_READ_END() \
+        } \
+    };
+
+JSON_BENCH_STRUCT(JsonScalar, BScalar, BENCH_SCALAR_FIELDS)
+JSON_BENCH_STRUCT(JsonStrings, BStrings, BENCH_STRINGS_FIELDS)
+JSON_BENCH_STRUCT(JsonIntVec, BIntVec, BENCH_INTVEC_FIELDS)
+JSON_BENCH_STRUCT(JsonDoubles, BDoubles, BENCH_DOUBLES_FIELDS)
+JSON_BENCH_STRUCT(JsonNested, BNested, BENCH_NESTED_FIELDS)
+JSON_BENCH_STRUCT(JsonTiny, BTiny, BENCH_TINY_FIELDS)
+
+template <typename T>
+static void run_json(const char * pShape)
+{
+    T obj;
+    bench_fill(obj);
+
+    if (bench_selected("json-stream", pShape))
+    {
+        std::string str;
+        Object2Json(obj, str);
+
+        bench_run("json-stream", pShape, "pack", str.size(), [&]()
+        {
+            std::string s;
+            Object2Json(obj, s);
+            bench_keep(s.size());
+        });
+        bench_run("json-stream", pShape, "unpack", str.size(), [&]()
+        {
+            T o;
+            bench_keep(Json2Object(str, o));
+        });
+    }
+
+    if (!bench_selected("json", pShape))
+        return;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    Json::CharReaderBuilder readerBuilder;
+
+    Json::Value jsObj;
+    obj.marshal(jsObj);
+    std::string str = Json::writeString(builder, jsObj);
+
+    bench_run("json", pShape, "pack", str.size(), [&]()
+    {
+        Json::Value js;
+        obj.marshal(js);
+        std::string s = Json::writeString(builder, js);
+        bench_keep(s.size());
+    });
+    bench_run("json", pShape, "unpack", str.size(), [&]()
+    {
+        Json::Value js;
+        std::string strErr;
+        std::unique_ptr<Json::CharReader> pReader(readerBuilder.newCharReader());
+        pReader->parse(str.data(), str.data() + str.size(), &js, &strErr);
+
+        T o;
+        o.unmarshal(js);
+        bench_keep(js.size());
+    });
+}
+
+void bench_backend()
+{
+    run_json<JsonScalar>("scalar");
+    run_json<JsonStrings>("strings");
+    run_json<JsonIntVec>("intvec");
+    run_json<JsonDoubles>("doubles");
+    run_json<JsonNested>("nested");
+    run_json<JsonTiny>("tiny");
+}
@@ -0,0 +1,77 @@
+// 序列化性能测试 =>
+// 每个后端与本文件一起编译为独立的程序：
+//   g++ -std=c++11 -O2 -I. bench/bench_main.cpp bench/bench_ds.cpp -pthread -o dsbench_ds
+//   g++ -std=c++11 -O2 -I. bench/bench_main.cpp bench/bench_simple.cpp -o dsbench_simple
+//   g++ -std=c++11 -O2 -I. -I/usr/include/jsoncpp bench/bench_main.cpp bench/bench_json.cpp -ljsoncpp -o dsbench_json
+// 运行：./dsbench_ds [过滤串]，过滤串匹配"后端/数据"，如 ./dsbench_ds ds/tiny
+// 输出为CSV，每行一个测试项
+
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+
+#include "bench.h"
+
+// 替换全局operator new以统计分配次数 =>
+// 只统计operator new，DSPackBuffer等经malloc/mmap/内存池分配的块不计入
+
+static std::atomic<uint64_t> g_nAllocCount(0);
+
+uint64_t bench_alloc_count()
+{
+    return g_nAllocCount.load(std::memory_order_relaxed);
+}
+
+void * operator new(size_t nSize)
+{
+    g_nAllocCount.fetch_add(1, std::memory_order_relaxed);
+    void * p = malloc(nSize > 0 ? nSize : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void * operator new[](size_t nSize)
+{
+    return operator new(nSize);
+}
+
+void * operator new(size_t nSize, const std::nothrow_t &) noexcept
+{
+    g_nAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc(nSize > 0 ? nSize : 1);
+}
+
+void * operator new[](size_t nSize, const std::nothrow_t & tag) noexcept
+{
+    return operator new(nSize, tag);
+}
+
+void operator delete(void * p) noexcept { free(p); }
+void operator delete[](void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+void operator delete[](void * p, size_t) noexcept { free(p); }
+void operator delete(void * p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void * p, const std::nothrow_t &) noexcept { free(p); }
+
+static const char * g_pFilter = NULL;
+
+bool bench_selected(const char * pBackend, const char * pShape)
+{
+    if (g_pFilter == NULL)
+        return true;
+
+    std::string strName = std::string(pBackend) + "/" + pShape;
+    return (strName.find(g_pFilter) != std::string::npos);
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc > 1)
+        g_pFilter = argv[1];
+
+    bench_header();
+    bench_backend();
+
+    return 0;
+}
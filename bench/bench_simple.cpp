@@ -0,0 +1,59 @@
+// simplemarshal后端 =>
+
+#include "simplemarshal/simplemarshal.h"
+
+#include "bench.h"
+
+using namespace dakuang;
+
+#define SIMPLE_PUT(f) p << f;
+#define SIMPLE_GET(f) up >> f;
+
+#define SIMPLE_BENCH_STRUCT(Name, Base, FIELDS) \
+    struct Name : public Base, public Marshallable \
+    { \
+        virtual void marshal(SimplePack & p) const { FIELDS(SIMPLE_PUT) } \
+        virtual void unmarshal(const SimpleUnpack & up) { FIELDS(SIMPLE_GET) } \
+    };
+
+SIMPLE_BENCH_STRUCT(SimpleScalar, BScalar, BENCH_SCALAR_FIELDS)
+SIMPLE_BENCH_STRUCT(SimpleStrings, BStrings, BENCH_STRINGS_FIELDS)
+SIMPLE_BENCH_STRUCT(SimpleIntVec, BIntVec, BENCH_INTVEC_FIELDS)
+SIMPLE_BENCH_STRUCT(SimpleDoubles, BDoubles, BENCH_DOUBLES_FIELDS)
+SIMPLE_BENCH_STRUCT(SimpleNested, BNested, BENCH_NESTED_FIELDS)
+SIMPLE_BENCH_STRUCT(SimpleTiny, BTiny, BENCH_TINY_FIELDS)
+
+template <typename T>
+static void run_simple(const char * pShape)
+{
+    if (!bench_selected("simple", pShape))
+        return;
+
+    T obj;
+    bench_fill(obj);
+
+    std::string str;
+    Object2String(obj, str);
+
+    bench_run("simple", pShape, "pack", str.size(), [&]()
+    {
+        std::string s;
+        Object2String(obj, s);
+        bench_keep(s.size());
+    });
+    bench_run("simple", pShape, "unpack", str.size(), [&]()
+    {
+        T o;
+        bench_keep(String2Object(str, o));
+    });
+}
+
+void bench_backend()
+{
+    run_simple<SimpleScalar>("scalar");
+    run_simple<SimpleStrings>("strings");
+    run_simple<SimpleIntVec>("intvec");
+    run_simple<SimpleDoubles>("doubles");
+    run_simple<SimpleNested>("nested");
+    run_simple<SimpleTiny>("tiny");
+}
@@ -4,6 +4,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <new>
+#include <vector>
+
+#include "dstypes.h"
+#include "dsstats.h"
+
+#if __cplusplus >= 201103L
+#include <mutex>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define DS_HAVE_MMAP
+#endif
 
 namespace dakuang
 {
@@ -22,6 +35,10 @@ struct SBlockAllocator_MallocFree
     {
         free(pBlock);
     }
+    static char * ordered_realloc(char * const pBlock, size_t, size_t NewBlockCount)
+    {
+        return (char *)realloc(pBlock, BlockSize * NewBlockCount);
+    }
 };
 
 template <unsigned int BlockSize>
@@ -39,9 +56,300 @@ struct SBlockAllocator_NewDelete
     }
 };
 
+// 池化分配器，按块数分级缓存已释放的内存 =>
+// 请求块数向上取整为2的幂(1,2,4...)作为级别，超过最大级别的直接走malloc/free；
+// 释放的内存先放入线程缓存，线程缓存满时批量归还全局缓存，全局缓存也满时才还给系统；
+// 线程缓存需要C++11的thread_local支持，否则退化为malloc/free
+
+template <unsigned int BlockSize, unsigned int ClassCount = 6,
+          size_t ThreadCacheBytes = 256 * 1024, size_t GlobalCacheBytes = 4 * 1024 * 1024>
+struct SBlockAllocator_Pool
+{
+    enum { blockSize = BlockSize };
+
+    static char * ordered_malloc(size_t BlockCount)
+    {
+        unsigned int nClass = __classOf(BlockCount);
+        if (nClass >= ClassCount)
+            return (char *)malloc(BlockSize * BlockCount);
+
+#if __cplusplus >= 201103L
+        SFreeList & tlist = __threadCache().lists[nClass];
+        if (tlist.pHead == NULL)
+            __globalCache().fetch(nClass, tlist, __cacheLimit(ThreadCacheBytes, nClass) / 2);
+
+        if (tlist.pHead != NULL)
+            return tlist.pop();
+#endif
+
+        return (char *)malloc(size_t(BlockSize) << nClass);
+    }
+
+    static void ordered_free(char * const pBlock, size_t BlockCount)
+    {
+#if __cplusplus >= 201103L
+        unsigned int nClass = __classOf(BlockCount);
+        if (nClass < ClassCount)
+        {
+            SFreeList & tlist = __threadCache().lists[nClass];
+            size_t nLimit = __cacheLimit(ThreadCacheBytes, nClass);
+
+            // 线程缓存已满，归还一半到全局缓存
+            if (tlist.nCount >= nLimit)
+                __globalCache().release(nClass, tlist, nLimit / 2 + 1);
+
+            tlist.push(pBlock);
+            return;
+        }
+#else
+        (void)BlockCount;
+#endif
+
+        free(pBlock);
+    }
+
+private:
+    struct SFreeList
+    {
+        char * pHead;
+        size_t nCount;
+
+        SFreeList() : pHead(NULL), nCount(0) {}
+
+        void push(char * pBlock)
+        {
+            *(char **)pBlock = pHead;
+            pHead = pBlock;
+            ++nCount;
+        }
+        char * pop()
+        {
+            char * pBlock = pHead;
+            pHead = *(char **)pBlock;
+            --nCount;
+            return pBlock;
+        }
+        void clear()
+        {
+            while (pHead != NULL)
+                free(pop());
+        }
+    };
+
+    static unsigned int __classOf(size_t BlockCount)
+    {
+        unsigned int nClass = 0;
+        while ((size_t(1) << nClass) < BlockCount)
+            ++nClass;
+        return nClass;
+    }
+
+    static size_t __cacheLimit(size_t nCacheBytes, unsigned int nClass)
+    {
+        size_t nLimit = nCacheBytes / (size_t(BlockSize) << nClass);
+        return (nLimit > 1 ? nLimit : 1);
+    }
+
+#if __cplusplus >= 201103L
+    struct SGlobalCache
+    {
+        std::mutex mutex;
+        SFreeList lists[ClassCount];
+
+        ~SGlobalCache()
+        {
+            for (unsigned int i = 0; i < ClassCount; ++i)
+                lists[i].clear();
+        }
+
+        // 从全局缓存取出最多nCount块到线程缓存
+        void fetch(unsigned int nClass, SFreeList & tlist, size_t nCount)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            SFreeList & glist = lists[nClass];
+            while (nCount-- > 0 && glist.pHead != NULL)
+                tlist.push(glist.pop());
+        }
+
+        // 从线程缓存归还nCount块到全局缓存，全局缓存满时释放给系统
+        void release(unsigned int nClass, SFreeList & tlist, size_t nCount)
+        {
+            size_t nLimit = __cacheLimit(GlobalCacheBytes, nClass);
+
+            std::lock_guard<std::mutex> guard(mutex);
+            SFreeList & glist = lists[nClass];
+            while (nCount-- > 0 && tlist.pHead != NULL)
+            {
+                if (glist.nCount < nLimit)
+                    glist.push(tlist.pop());
+                else
+                    free(tlist.pop());
+            }
+        }
+    };
+
+    struct SThreadCache
+    {
+        SFreeList lists[ClassCount];
+
+        ~SThreadCache()
+        {
+            for (unsigned int i = 0; i < ClassCount; ++i)
+                __globalCache().release(i, lists[i], lists[i].nCount);
+        }
+    };
+
+    static SGlobalCache & __globalCache()
+    {
+        static SGlobalCache cache;
+        return cache;
+    }
+
+    static SThreadCache & __threadCache()
+    {
+        static thread_local SThreadCache cache;
+        return cache;
+    }
+#endif
+};
+
+// 支持原地扩容的分配器可额外提供:
+//     static char * ordered_realloc(char * const pBlock, size_t OldBlockCount, size_t NewBlockCount);
+// DSBuffer扩容时会优先使用该方法，避免malloc+memcpy+free
+
+// 匿名内存映射分配器，用于数百M以上的大缓冲区 =>
+// 映射的页在首次写入时才分配物理内存；Linux下用mremap扩容，只重新映射页表而不复制数据，
+// 不会出现新旧两份内存同时存在的峰值；HugePage为true时建议内核对2M以上的映射使用透明大页；
+// 不支持mmap的平台退化为malloc/free
+
+template <unsigned int BlockSize, bool HugePage = false>
+struct SBlockAllocator_Mmap
+{
+    enum { blockSize = BlockSize };
+
+#if defined(DS_HAVE_MMAP)
+    static char * ordered_malloc(size_t BlockCount)
+    {
+        size_t nSize = size_t(BlockSize) * BlockCount;
+        void * pBlock = mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pBlock == MAP_FAILED)
+            return NULL;
+
+        __advise(pBlock, nSize);
+        return (char *)pBlock;
+    }
+    static void ordered_free(char * const pBlock, size_t BlockCount)
+    {
+        munmap(pBlock, size_t(BlockSize) * BlockCount);
+    }
+#if defined(MREMAP_MAYMOVE)
+    static char * ordered_realloc(char * const pBlock, size_t OldBlockCount, size_t NewBlockCount)
+    {
+        size_t nSize = size_t(BlockSize) * NewBlockCount;
+        void * pNew = mremap(pBlock, size_t(BlockSize) * OldBlockCount, nSize, MREMAP_MAYMOVE);
+        if (pNew == MAP_FAILED)
+            return NULL;
+
+        __advise(pNew, nSize);
+        return (char *)pNew;
+    }
+#endif
+
+private:
+    static void __advise(void * pBlock, size_t nSize)
+    {
+#if defined(MADV_HUGEPAGE)
+        if (HugePage && nSize >= 2 * 1024 * 1024)
+            madvise(pBlock, nSize, MADV_HUGEPAGE);
+#else
+        (void)pBlock;
+        (void)nSize;
+#endif
+    }
+#else
+    static char * ordered_malloc(size_t BlockCount)
+    {
+        return (char *)malloc(BlockSize * BlockCount);
+    }
+    static void ordered_free(char * const pBlock, size_t)
+    {
+        free(pBlock);
+    }
+    static char * ordered_realloc(char * const pBlock, size_t, size_t NewBlockCount)
+    {
+        return (char *)realloc(pBlock, BlockSize * NewBlockCount);
+    }
+#endif
+};
+
+template <typename BlockAllocator>
+struct SBlockAllocatorTraits
+{
+    typedef char yes[1];
+    typedef char no[2];
+
+    template <typename U, char * (*)(char * const, size_t, size_t)> struct SCheck;
+    template <typename U> static yes & test(SCheck<U, &U::ordered_realloc> *);
+    template <typename U> static no & test(...);
+
+    enum { canRealloc = (sizeof(test<BlockAllocator>(0)) == sizeof(yes)) };
+};
+
+// 扩容时有效数据为[nHead, nHead + nUsedSize)：分配新块时只复制有效数据并把nHead置0，
+// 原地扩容时数据位置不变，nHead保持不变
+template <typename BlockAllocator, bool CanRealloc = SBlockAllocatorTraits<BlockAllocator>::canRealloc>
+struct SBlockReallocator
+{
+    static char * ordered_realloc(char * const pBlock, size_t OldBlockCount, size_t NewBlockCount, size_t & nHead, size_t nUsedSize)
+    {
+        char * pNew = BlockAllocator::ordered_malloc(NewBlockCount);
+        if (pNew == NULL)
+            return NULL;
+
+        DS_STATS_ADD(nMallocCount, 1);
+        DS_STATS_ADD(nMallocBytes, size_t(BlockAllocator::blockSize) * NewBlockCount);
+
+        if (OldBlockCount > 0)
+        {
+            memcpy(pNew, pBlock + nHead, nUsedSize);
+            nHead = 0;
+            BlockAllocator::ordered_free(pBlock, OldBlockCount);
+
+            DS_STATS_ADD(nGrowCopyBytes, nUsedSize);
+            DS_STATS_ADD(nFreeCount, 1);
+        }
+
+        return pNew;
+    }
+};
+
+template <typename BlockAllocator>
+struct SBlockReallocator<BlockAllocator, true>
+{
+    static char * ordered_realloc(char * const pBlock, size_t OldBlockCount, size_t NewBlockCount, size_t &, size_t)
+    {
+        if (OldBlockCount == 0)
+        {
+            DS_STATS_ADD(nMallocCount, 1);
+            DS_STATS_ADD(nMallocBytes, size_t(BlockAllocator::blockSize) * NewBlockCount);
+            return BlockAllocator::ordered_malloc(NewBlockCount);
+        }
+
+        DS_STATS_ADD(nReallocCount, 1);
+        return BlockAllocator::ordered_realloc(pBlock, OldBlockCount, NewBlockCount);
+    }
+};
+
 #define USE_NEW_ALLOCATOR
 
-#ifdef  USE_NEW_ALLOCATOR
+#if defined(USE_POOL_ALLOCATOR)
+typedef SBlockAllocator_Pool<1 * 1024> BLOCK_ALLOC_1K;
+typedef SBlockAllocator_Pool<2 * 1024> BLOCK_ALLOC_2K;
+typedef SBlockAllocator_Pool<4 * 1024> BLOCK_ALLOC_4K;
+typedef SBlockAllocator_Pool<8 * 1024> BLOCK_ALLOC_8K;
+typedef SBlockAllocator_Pool<16 * 1024> BLOCK_ALLOC_16K;
+typedef SBlockAllocator_Pool<32 * 1024> BLOCK_ALLOC_32K;
+#elif defined(USE_NEW_ALLOCATOR)
 typedef SBlockAllocator_NewDelete<1 * 1024> BLOCK_ALLOC_1K;
 typedef SBlockAllocator_NewDelete<2 * 1024> BLOCK_ALLOC_2K;
 typedef SBlockAllocator_NewDelete<4 * 1024> BLOCK_ALLOC_4K;
@@ -57,13 +365,82 @@ typedef SBlockAllocator_MallocFree<16 * 1024> BLOCK_ALLOC_16K;
 typedef SBlockAllocator_MallocFree<32 * 1024> BLOCK_ALLOC_32K;
 #endif
 
+typedef SBlockAllocator_Mmap<4 * 1024> BLOCK_ALLOC_MMAP;
+typedef SBlockAllocator_Mmap<4 * 1024, true> BLOCK_ALLOC_MMAP_HUGEPAGE;
+
+// 扩容策略定义 =>
+
+// 按需扩容，只补足缺少的块数
+struct SGrowthPolicy_Exact
+{
+    static size_t newBlockCount(size_t, size_t nNeedBlockCount)
+    {
+        return nNeedBlockCount;
+    }
+};
+
+// 按比例扩容，新块数至少为当前块数的Numerator/Denominator倍
+template <unsigned int Numerator, unsigned int Denominator>
+struct SGrowthPolicy_Geometric
+{
+    static size_t newBlockCount(size_t nCurBlockCount, size_t nNeedBlockCount)
+    {
+        size_t nGrowBlockCount = nCurBlockCount * Numerator / Denominator;
+        return (nGrowBlockCount > nNeedBlockCount ? nGrowBlockCount : nNeedBlockCount);
+    }
+};
+
+// 按倍数扩容，但单次最多增加CapBlockCount块
+template <unsigned int CapBlockCount>
+struct SGrowthPolicy_CappedGeometric
+{
+    static size_t newBlockCount(size_t nCurBlockCount, size_t nNeedBlockCount)
+    {
+        size_t nGrowBlockCount = nCurBlockCount + (nCurBlockCount < CapBlockCount ? nCurBlockCount : CapBlockCount);
+        return (nGrowBlockCount > nNeedBlockCount ? nGrowBlockCount : nNeedBlockCount);
+    }
+};
+
+typedef SGrowthPolicy_Exact GROWTH_EXACT;
+typedef SGrowthPolicy_Geometric<3, 2> GROWTH_1_5X;
+typedef SGrowthPolicy_Geometric<2, 1> GROWTH_2X;
+typedef SGrowthPolicy_CappedGeometric<16 * 1024> GROWTH_CAPPED_2X;
+
+// 缓冲区内存块，用于将内存的所有权移交给调用者 =>
+
+struct DSBufferBlock
+{
+    char * pData;
+    size_t nSize;
+    size_t nBlockCount;
+    void (*pfnFree)(char * const, size_t);
+
+    DSBufferBlock() : pData(NULL), nSize(0), nBlockCount(0), pfnFree(NULL) {}
+
+    // 使用原分配器释放内存块
+    void deallocate()
+    {
+        if (pData != NULL && pfnFree != NULL)
+        {
+            pfnFree(pData, nBlockCount);
+            DS_STATS_ADD(nFreeCount, 1);
+        }
+
+        pData = NULL;
+        nSize = 0;
+        nBlockCount = 0;
+    }
+};
+
 // 数据序列化缓冲 =>
+// 从头部消费数据时只推进读位置m_nHead，尾部空间不足时才把剩余数据搬移到头部
 
-template <typename BlockAllocator = BLOCK_ALLOC_4K, unsigned int MaxBlockCount = 1024>
+template <typename BlockAllocator = BLOCK_ALLOC_4K, unsigned int MaxBlockCount = 1024, typename GrowthPolicy = GROWTH_EXACT>
 class DSBuffer
 {
 private:
     char * m_pData;
+    size_t m_nHead;
     size_t m_nSize;
     size_t m_nBlockCount;
 
@@ -71,19 +448,45 @@ public:
     enum { maxBlockCount = MaxBlockCount };
 
     typedef BlockAllocator allocator;
+    typedef GrowthPolicy growth_policy;
 
-    DSBuffer() : m_pData(NULL), m_nSize(0), m_nBlockCount(0) {}
+    DSBuffer() : m_pData(NULL), m_nHead(0), m_nSize(0), m_nBlockCount(0) {}
     virtual ~DSBuffer() { __free(); }
 
-    char * data() { return m_pData; }
+#if __cplusplus >= 201103L
+    DSBuffer(DSBuffer && o) : m_pData(NULL), m_nHead(0), m_nSize(0), m_nBlockCount(0) { swap(o); }
+    DSBuffer & operator = (DSBuffer && o)
+    {
+        if (this != &o)
+        {
+            __free();
+            swap(o);
+        }
+        return *this;
+    }
+#endif
+
+    void swap(DSBuffer & o)
+    {
+        char * pData = m_pData; m_pData = o.m_pData; o.m_pData = pData;
+        size_t nHead = m_nHead; m_nHead = o.m_nHead; o.m_nHead = nHead;
+        size_t nSize = m_nSize; m_nSize = o.m_nSize; o.m_nSize = nSize;
+        size_t nBlockCount = m_nBlockCount; m_nBlockCount = o.m_nBlockCount; o.m_nBlockCount = nBlockCount;
+    }
+
+    // 交出内存块的所有权，调用者需通过DSBufferBlock::deallocate()释放；交出前先把数据搬移到头部
+    inline DSBufferBlock release();
+
+    char * data() { return m_pData + m_nHead; }
+    const char * data() const { return m_pData + m_nHead; }
     size_t size() const { return m_nSize; }
 
     bool empty() const	 { return size() == 0; }
     size_t blockCount() const	 { return m_nBlockCount; }
     size_t blockSize() const { return allocator::blockSize; }
     size_t capacity() const  { return allocator::blockSize * m_nBlockCount; }
-    size_t maxCapacity() const	 { return allocator::blockSize * maxBlockCount; }
-    size_t curFreeSize() const { return capacity() - size(); }
+    size_t maxCapacity() const	 { return size_t(allocator::blockSize) * maxBlockCount; }
+    size_t curFreeSize() const { return capacity() - m_nHead - size(); }
     size_t maxFreeSize() const	 { return maxCapacity() - size(); }
 
     inline bool reserve(size_t nSize);
@@ -92,9 +495,36 @@ public:
     inline bool replace(size_t nPos, const char * pData, size_t nSize);
     inline bool erase(size_t nPos, size_t nSize = size_t(-1), bool bFree = true);
 
+    // 从头部消费nSize字节，只推进读位置；之后搬移剩余数据的代价不超过消费的数据量
+    void consume(size_t nSize)
+    {
+        if (nSize >= size())
+        {
+            m_nHead = 0;
+            m_nSize = 0;
+        }
+        else
+        {
+            m_nHead += nSize;
+            m_nSize -= nSize;
+        }
+    }
+
+    // 直接写入尾部空闲空间后，用commit()提交写入的长度
+    char * tail() { return __tail(); }
+    bool commit(size_t nSize)
+    {
+        if (nSize > curFreeSize())
+            return false;
+
+        m_nSize += nSize;
+        return true;
+    }
+
 protected:
-    char * __tail() { return m_pData + m_nSize; }
+    char * __tail() { return m_pData + m_nHead + m_nSize; }
     inline void __free();
+    inline void __compact();
     inline bool __increaseCapacity(size_t nSize);
 
 private:
@@ -102,15 +532,16 @@ private:
     void operator = (const DSBuffer &) {}
 };
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline bool DSBuffer<BlockAllocator, MaxBlockCount >::reserve(size_t nSize)
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline bool DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::reserve(size_t nSize)
 {
     // 容量不够扩容
-    return (nSize <= capacity() || __increaseCapacity(nSize - capacity()));
+    size_t nCapacity = capacity() - m_nHead;
+    return (nSize <= nCapacity || __increaseCapacity(nSize - nCapacity));
 }
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline bool DSBuffer<BlockAllocator, MaxBlockCount >::resize(size_t nSize, char cChar)
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline bool DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::resize(size_t nSize, char cChar)
 {
     if (nSize > size())
     {
@@ -124,12 +555,14 @@ inline bool DSBuffer<BlockAllocator, MaxBlockCount >::resize(size_t nSize, char
     }
 
     m_nSize = nSize;
+    if (m_nSize == 0)
+        m_nHead = 0;
 
     return true;
 }
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline bool DSBuffer<BlockAllocator, MaxBlockCount >::append(const char * pData, size_t nSize)
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline bool DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::append(const char * pData, size_t nSize)
 {
     if (nSize == 0)
         return true;
@@ -144,8 +577,8 @@ inline bool DSBuffer<BlockAllocator, MaxBlockCount >::append(const char * pData,
     return true;
 }
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline bool DSBuffer<BlockAllocator, MaxBlockCount >::replace(size_t nPos, const char * pData, size_t nSize)
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline bool DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::replace(size_t nPos, const char * pData, size_t nSize)
 {
     if (nSize == 0)
         return true;
@@ -161,13 +594,13 @@ inline bool DSBuffer<BlockAllocator, MaxBlockCount >::replace(size_t nPos, const
             return false;
     }
 
-    memcpy(m_pData + nPos, pData, nSize);
+    memcpy(data() + nPos, pData, nSize);
 
     return true;
 }
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline bool DSBuffer<BlockAllocator, MaxBlockCount >::erase(size_t nPos, size_t nSize, bool bFree)
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline bool DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::erase(size_t nPos, size_t nSize, bool bFree)
 {
     if (nSize == 0)
         return true;
@@ -181,11 +614,16 @@ inline bool DSBuffer<BlockAllocator, MaxBlockCount >::erase(size_t nPos, size_t
     {
         resize(nPos);
     }
-    // 没有超过当前长度，搬移内存
+    // 从头部删除，只推进读位置
+    else if (nPos == 0)
+    {
+        consume(nSize);
+    }
+    // 没有超过当前长度，搬移内存(区域可能重叠)
     else
     {
         size_t nMoveSize = size() - (nPos + nSize);
-        memcpy(m_pData + nPos, m_pData + nPos + nSize, nMoveSize);
+        memmove(data() + nPos, data() + nPos + nSize, nMoveSize);
         m_nSize -= nSize;
     }
 
@@ -194,46 +632,330 @@ inline bool DSBuffer<BlockAllocator, MaxBlockCount >::erase(size_t nPos, size_t
     {
         __free();
     }
+
+    return true;
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline DSBufferBlock DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::release()
+{
+    DSBufferBlock block;
+
+    if (m_nBlockCount > 0)
+    {
+        __compact();
+
+        block.pData = m_pData;
+        block.nSize = m_nSize;
+        block.nBlockCount = m_nBlockCount;
+        block.pfnFree = &allocator::ordered_free;
+
+        m_pData = NULL;
+        m_nSize = 0;
+        m_nBlockCount = 0;
+    }
+
+    return block;
 }
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline void DSBuffer<BlockAllocator, MaxBlockCount >::__free()
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline void DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::__free()
 {
     if (m_nBlockCount > 0)
     {
         allocator::ordered_free(m_pData, m_nBlockCount);
+        DS_STATS_ADD(nFreeCount, 1);
 
         m_pData = NULL;
+        m_nHead = 0;
         m_nSize = 0;
         m_nBlockCount = 0;
     }
 }
 
-template <typename BlockAllocator, unsigned int MaxBlockCount>
-inline bool DSBuffer<BlockAllocator, MaxBlockCount >::__increaseCapacity(size_t nSize)
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline void DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::__compact()
+{
+    if (m_nHead == 0)
+        return;
+
+    memmove(m_pData, m_pData + m_nHead, m_nSize);
+    m_nHead = 0;
+
+    DS_STATS_ADD(nCompactBytes, m_nSize);
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount, typename GrowthPolicy>
+inline bool DSBuffer<BlockAllocator, MaxBlockCount, GrowthPolicy >::__increaseCapacity(size_t nSize)
 {
     if (nSize == 0)
         return true;
 
+    // 头部已消费的空间不少于剩余数据时，才把剩余数据搬移到头部，搬移的数据不超过腾出的空间；
+    // 否则不搬移，直接扩容，分配新块时只复制剩余数据。扩容本身的均摊代价取决于扩容策略，
+    // GROWTH_EXACT每次只扩到所需块数，持续增长的队列应使用按倍数扩容的策略
+    size_t nHead = m_nHead;
+    size_t nNeedSize = nSize;
+    if (nHead > 0 && nHead >= m_nSize)
+    {
+        __compact();
+
+        if (nSize <= nHead)
+            return true;
+
+        nSize -= nHead;
+        nHead = 0;
+    }
+
     size_t nIncreaseBlockCount = nSize / blockSize();
     if ((nSize % blockSize()) != 0)
         nIncreaseBlockCount++;
 
+    // 达到最大块数时，搬移腾出的空间够用也算成功
     if (m_nBlockCount + nIncreaseBlockCount > maxBlockCount)
-        return false;
+    {
+        if (nNeedSize > nHead)
+            return false;
 
-    char * pNew = (char*)(allocator::ordered_malloc( m_nBlockCount + nIncreaseBlockCount ));
+        __compact();
+        return true;
+    }
+
+    // 按扩容策略计算新块数，不超过最大块数
+    size_t nNewBlockCount = growth_policy::newBlockCount(m_nBlockCount, m_nBlockCount + nIncreaseBlockCount);
+    if (nNewBlockCount > maxBlockCount)
+        nNewBlockCount = maxBlockCount;
+
+    char * pNew = SBlockReallocator<allocator>::ordered_realloc(m_pData, m_nBlockCount, nNewBlockCount, m_nHead, m_nSize);
     if (pNew == NULL)
         return false;
 
-    if (m_nBlockCount > 0)
+    m_pData = pNew;
+    m_nBlockCount = nNewBlockCount;
+
+    DS_STATS_ADD(nGrowCount, 1);
+    DS_STATS_MAX(nPeakCapacity, capacity());
+
+    return true;
+}
+
+// 分段数据序列化缓冲 =>
+// 由多个固定大小的块串联而成，追加数据时只分配新块，已写入的数据不会被搬移；
+// 除最后一块外每块都是满的，因此任意位置都能直接定位到所在的块
+
+template <typename BlockAllocator = BLOCK_ALLOC_4K, unsigned int MaxBlockCount = 1024>
+class DSChainBuffer
+{
+private:
+    std::vector<char *> m_vecBlock;
+    size_t m_nSize;
+
+public:
+    enum { maxBlockCount = MaxBlockCount };
+
+    typedef BlockAllocator allocator;
+
+    DSChainBuffer() : m_nSize(0) {}
+    virtual ~DSChainBuffer() { __free(); }
+
+    size_t size() const { return m_nSize; }
+
+    bool empty() const	 { return size() == 0; }
+    size_t blockCount() const	 { return m_vecBlock.size(); }
+    size_t blockSize() const { return allocator::blockSize; }
+    size_t capacity() const  { return allocator::blockSize * m_vecBlock.size(); }
+    size_t maxCapacity() const	 { return size_t(allocator::blockSize) * maxBlockCount; }
+    size_t curFreeSize() const { return capacity() - size(); }
+    size_t maxFreeSize() const	 { return maxCapacity() - size(); }
+
+    // 返回第nIndex块的地址及有效长度
+    char * blockData(size_t nIndex) { return m_vecBlock[nIndex]; }
+    size_t blockDataSize(size_t nIndex) const
     {
-        memcpy(pNew, m_pData, m_nSize);
-        allocator::ordered_free(m_pData, m_nBlockCount);
+        return (nIndex + 1 < m_vecBlock.size() ? blockSize() : m_nSize - nIndex * blockSize());
     }
 
-    m_pData = pNew;
-    m_nBlockCount = m_nBlockCount + nIncreaseBlockCount;
+    inline bool resize(size_t nSize, char cChar = 0);
+    inline bool append(const char * pData, size_t nSize);
+    inline bool replace(size_t nPos, const char * pData, size_t nSize);
+    inline void clear();
+
+    // 从nPos起复制nSize字节到pDst，返回实际复制的长度
+    inline size_t copyTo(char * pDst, size_t nPos = 0, size_t nSize = size_t(-1)) const;
+
+    // 导出为iovec数组，可直接用于writev/sendmsg
+    size_t iovecCount() const { return (m_nSize + blockSize() - 1) / blockSize(); }
+    inline size_t exportIovec(struct iovec * pIov, size_t nIovCount) const;
+
+protected:
+    inline void __free();
+    inline bool __increaseBlock();
+
+private:
+    DSChainBuffer(const DSChainBuffer &) {}
+    void operator = (const DSChainBuffer &) {}
+};
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline bool DSChainBuffer<BlockAllocator, MaxBlockCount >::resize(size_t nSize, char cChar)
+{
+    // 扩大时逐块填充
+    while (nSize > size())
+    {
+        if (curFreeSize() == 0 && !__increaseBlock())
+            return false;
+
+        size_t nOffset = m_nSize % blockSize();
+        size_t nFill = blockSize() - nOffset;
+        if (nFill > nSize - size())
+            nFill = nSize - size();
+
+        memset(m_vecBlock.back() + nOffset, cChar, nFill);
+        m_nSize += nFill;
+    }
+
+    // 缩小时释放多余的块
+    m_nSize = nSize;
+    while (capacity() - m_nSize >= blockSize())
+    {
+        allocator::ordered_free(m_vecBlock.back(), 1);
+        m_vecBlock.pop_back();
+        DS_STATS_ADD(nFreeCount, 1);
+    }
+
+    return true;
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline bool DSChainBuffer<BlockAllocator, MaxBlockCount >::append(const char * pData, size_t nSize)
+{
+    if (nSize > maxFreeSize())
+        return false;
+
+    while (nSize > 0)
+    {
+        if (curFreeSize() == 0 && !__increaseBlock())
+            return false;
+
+        size_t nOffset = m_nSize % blockSize();
+        size_t nCopy = blockSize() - nOffset;
+        if (nCopy > nSize)
+            nCopy = nSize;
+
+        memcpy(m_vecBlock.back() + nOffset, pData, nCopy);
+        m_nSize += nCopy;
+        pData += nCopy;
+        nSize -= nCopy;
+    }
+
+    return true;
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline bool DSChainBuffer<BlockAllocator, MaxBlockCount >::replace(size_t nPos, const char * pData, size_t nSize)
+{
+    if (nSize == 0)
+        return true;
+
+    // 替换区在当前数据之外
+    if (nPos >= size())
+        return append(pData, nSize);
+
+    // 替换区超过当前长度的部分追加到尾部
+    size_t nInner = size() - nPos;
+    if (nInner > nSize)
+        nInner = nSize;
+
+    // 替换区可能跨越多个块
+    size_t nIndex = nPos / blockSize();
+    size_t nOffset = nPos % blockSize();
+    for (size_t nLeft = nInner; nLeft > 0; ++nIndex, nOffset = 0)
+    {
+        size_t nCopy = blockSize() - nOffset;
+        if (nCopy > nLeft)
+            nCopy = nLeft;
+
+        memcpy(m_vecBlock[nIndex] + nOffset, pData, nCopy);
+        pData += nCopy;
+        nLeft -= nCopy;
+    }
+
+    return append(pData, nSize - nInner);
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline void DSChainBuffer<BlockAllocator, MaxBlockCount >::clear()
+{
+    __free();
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline size_t DSChainBuffer<BlockAllocator, MaxBlockCount >::copyTo(char * pDst, size_t nPos, size_t nSize) const
+{
+    if (nPos >= size())
+        return 0;
+
+    if (nSize > size() - nPos)
+        nSize = size() - nPos;
+
+    size_t nIndex = nPos / blockSize();
+    size_t nOffset = nPos % blockSize();
+    for (size_t nLeft = nSize; nLeft > 0; ++nIndex, nOffset = 0)
+    {
+        size_t nCopy = blockSize() - nOffset;
+        if (nCopy > nLeft)
+            nCopy = nLeft;
+
+        memcpy(pDst, m_vecBlock[nIndex] + nOffset, nCopy);
+        pDst += nCopy;
+        nLeft -= nCopy;
+    }
+
+    return nSize;
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline size_t DSChainBuffer<BlockAllocator, MaxBlockCount >::exportIovec(struct iovec * pIov, size_t nIovCount) const
+{
+    size_t nCount = iovecCount();
+    if (nCount > nIovCount)
+        nCount = nIovCount;
+
+    for (size_t i = 0; i < nCount; ++i)
+    {
+        pIov[i].iov_base = m_vecBlock[i];
+        pIov[i].iov_len = blockDataSize(i);
+    }
+
+    return nCount;
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline void DSChainBuffer<BlockAllocator, MaxBlockCount >::__free()
+{
+    for (size_t i = 0; i < m_vecBlock.size(); ++i)
+        allocator::ordered_free(m_vecBlock[i], 1);
+    DS_STATS_ADD(nFreeCount, m_vecBlock.size());
+
+    m_vecBlock.clear();
+    m_nSize = 0;
+}
+
+template <typename BlockAllocator, unsigned int MaxBlockCount>
+inline bool DSChainBuffer<BlockAllocator, MaxBlockCount >::__increaseBlock()
+{
+    if (m_vecBlock.size() >= maxBlockCount)
+        return false;
+
+    char * pNew = allocator::ordered_malloc(1);
+    if (pNew == NULL)
+        return false;
+
+    m_vecBlock.push_back(pNew);
+
+    DS_STATS_ADD(nMallocCount, 1);
+    DS_STATS_ADD(nMallocBytes, blockSize());
+    DS_STATS_MAX(nPeakCapacity, capacity());
 
     return true;
 }
@@ -0,0 +1,119 @@
+﻿#ifndef __DSFRAME_H__
+#define __DSFRAME_H__
+
+#include "dspacket.h"
+
+namespace dakuang
+{
+
+// 定义长度前缀的帧解码器，帧格式为4字节包体长度(按线上字节序，不受紧凑模式影响)加包体。
+// recv()/read()直接写入缓冲区尾部，完整的帧以DSUnpack视图返回，不再复制；
+// 取出帧只通过DSBuffer::consume()推进读位置，尾部空间不足时才把未完成的部分搬到缓冲区头部
+class DSFrameDecoder
+{
+private:
+    // 最大1G的接收缓冲区
+    typedef DSBuffer<BLOCK_ALLOC_4K, 1024 * 256, GROWTH_2X> DSBuffer_t;
+    DSBuffer_t m_buffer;
+    uint32_t m_nMaxFrameSize;
+    bool m_bBad;
+
+    DSFrameDecoder(const DSFrameDecoder &);
+    DSFrameDecoder & operator = (const DSFrameDecoder &);
+
+public:
+    enum { headerSize = 4 };
+
+    explicit DSFrameDecoder(uint32_t nMaxFrameSize = 16 * 1024 * 1024)
+        : m_nMaxFrameSize(nMaxFrameSize)
+        , m_bBad(false)
+    {
+    }
+
+    uint32_t maxFrameSize() const { return m_nMaxFrameSize; }
+
+    // 收到的帧长超过上限，此后不再解出任何帧，连接应当关闭
+    bool bad() const { return m_bBad; }
+
+    // 尚未取出的数据
+    const char * data() { return m_buffer.data(); }
+    size_t size() const { return m_buffer.size(); }
+
+    void clear()
+    {
+        m_buffer.resize(0);
+        m_bBad = false;
+    }
+
+    // 准备至少nSize字节的尾部空间并返回写入地址，失败返回NULL；写入后用commit()提交实际长度。
+    // 之前取出的帧视图随之失效
+    inline char * prepare(size_t nSize);
+    size_t writable() const { return m_buffer.curFreeSize(); }
+    bool commit(size_t nSize) { return m_buffer.commit(nSize); }
+
+    // 复制写入一段数据，用于无法直接写入尾部的数据来源
+    bool feed(const void * pData, size_t nSize)
+    {
+        char * pTail = prepare(nSize);
+        if (pTail == NULL)
+            return false;
+
+        memcpy(pTail, pData, nSize);
+        return commit(nSize);
+    }
+
+    // 取出下一个完整帧的包体，数据不足或帧长超限时返回false(通过bad()区分)；
+    // 视图在下一次prepare()/feed()之前有效
+    inline bool next(const DSUnpack & up);
+};
+
+inline char * DSFrameDecoder::prepare(size_t nSize)
+{
+    if (nSize > m_buffer.curFreeSize() && !m_buffer.reserve(m_buffer.size() + nSize))
+        return NULL;
+
+    return m_buffer.tail();
+}
+
+inline bool DSFrameDecoder::next(const DSUnpack & up)
+{
+    if (m_bBad || size() < headerSize)
+        return false;
+
+    uint32_t u32;
+    memcpy(&u32, data(), headerSize);
+    u32 = DSWireOrder::conv32(u32);
+
+    if (u32 > m_nMaxFrameSize)
+    {
+        m_bBad = true;
+        return false;
+    }
+
+    if (size() - headerSize < u32)
+        return false;
+
+    up.reset(data() + headerSize, u32);
+    m_buffer.consume(headerSize + u32);
+    DS_STATS_UNPACK(u32);
+
+    return true;
+}
+
+// 将对象序列化为一帧追加到压包缓冲区，与DSFrameDecoder对应
+template <typename T>
+inline void Object2Frame(const T & obj, DSPackBuffer & buffer)
+{
+    size_t nPos = buffer.size();
+
+    DSPack pack(buffer, DSFrameDecoder::headerSize);
+    pack << obj;
+
+    pack.replace_uint32(nPos, uint32_t(pack.size()));
+
+    DS_STATS_PACK(obj, pack.size());
+}
+
+}
+
+#endif // __DSFRAME_H__
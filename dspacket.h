@@ -3,11 +3,30 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
+#include <deque>
+#include <list>
+#if __cplusplus >= 201103L
+#include <utility>
+#include <type_traits>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#endif
+#if __cplusplus >= 201703L
+#include <optional>
+#include <variant>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 #include "dstypes.h"
 #include "dsbuffer.h"
@@ -15,24 +34,181 @@
 namespace dakuang
 {
 
-// 本地字节序 -> 网络字节序
-inline uint16_t DS_HTONS(uint16_t u16)
+// 本机字节序检测DS_HOST_BIG_ENDIAN与单个整数的字节交换DS_BSWAP16/32/64定义在dstypes.h中
+
+// 批量字节交换，pDst与pSrc可以相同或不对齐；
+// 编译时启用SSSE3/AVX2则按16/32字节一组用shuffle指令转换，其余部分逐个转换
+inline void DS_BSWAP16_N(void * pDst, const void * pSrc, size_t nCount)
 {
-    return ( (u16 << 8) | (u16 >> 8) );
+    char * d = (char *)pDst;
+    const char * s = (const char *)pSrc;
+    size_t i = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+#if defined(__AVX2__)
+    const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+    for (; i + 16 <= nCount; i += 16)
+        _mm256_storeu_si256((__m256i *)(d + i * 2), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(s + i * 2)), mask2));
+#endif
+    for (; i + 8 <= nCount; i += 8)
+        _mm_storeu_si128((__m128i *)(d + i * 2), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + i * 2)), mask));
+#endif
+
+    for (; i < nCount; ++i)
+    {
+        uint16_t u16;
+        memcpy(&u16, s + i * 2, 2);
+        u16 = DS_BSWAP16(u16);
+        memcpy(d + i * 2, &u16, 2);
+    }
 }
-inline uint32_t DS_HTONL(uint32_t u32)
+inline void DS_BSWAP32_N(void * pDst, const void * pSrc, size_t nCount)
 {
-    return ( (uint32_t(DS_HTONS(uint16_t(u32))) << 16) | DS_HTONS(uint16_t(u32 >> 16)) );
+    char * d = (char *)pDst;
+    const char * s = (const char *)pSrc;
+    size_t i = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+#if defined(__AVX2__)
+    const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+    for (; i + 8 <= nCount; i += 8)
+        _mm256_storeu_si256((__m256i *)(d + i * 4), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(s + i * 4)), mask2));
+#endif
+    for (; i + 4 <= nCount; i += 4)
+        _mm_storeu_si128((__m128i *)(d + i * 4), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + i * 4)), mask));
+#endif
+
+    for (; i < nCount; ++i)
+    {
+        uint32_t u32;
+        memcpy(&u32, s + i * 4, 4);
+        u32 = DS_BSWAP32(u32);
+        memcpy(d + i * 4, &u32, 4);
+    }
 }
-inline uint64_t DS_HTONLL(uint64_t u64)
+inline void DS_BSWAP64_N(void * pDst, const void * pSrc, size_t nCount)
 {
-    return ( (uint64_t(DS_HTONL(uint32_t(u64))) << 32) | DS_HTONL(uint32_t(u64 >> 32)) );
+    char * d = (char *)pDst;
+    const char * s = (const char *)pSrc;
+    size_t i = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+    const __m128i mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+#if defined(__AVX2__)
+    const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+    for (; i + 4 <= nCount; i += 4)
+        _mm256_storeu_si256((__m256i *)(d + i * 8), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(s + i * 8)), mask2));
+#endif
+    for (; i + 2 <= nCount; i += 2)
+        _mm_storeu_si128((__m128i *)(d + i * 8), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + i * 8)), mask));
+#endif
+
+    for (; i < nCount; ++i)
+    {
+        uint64_t u64;
+        memcpy(&u64, s + i * 8, 8);
+        u64 = DS_BSWAP64(u64);
+        memcpy(d + i * 8, &u64, 8);
+    }
 }
 
+// 不需要交换时的批量复制
+inline void DS_BCOPY_N(void * pDst, const void * pSrc, size_t nSize)
+{
+    if (pDst != pSrc && nSize > 0)
+        memmove(pDst, pSrc, nSize);
+}
+
+#ifdef DS_HOST_BIG_ENDIAN
+
+// 本地字节序 -> 网络字节序(大端)
+inline uint16_t DS_HTONS(uint16_t u16) { return u16; }
+inline uint32_t DS_HTONL(uint32_t u32) { return u32; }
+inline uint64_t DS_HTONLL(uint64_t u64) { return u64; }
+inline void DS_HTONS_N(void * pDst, const void * pSrc, size_t nCount) { DS_BCOPY_N(pDst, pSrc, nCount * 2); }
+inline void DS_HTONL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BCOPY_N(pDst, pSrc, nCount * 4); }
+inline void DS_HTONLL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BCOPY_N(pDst, pSrc, nCount * 8); }
+
+// 本地字节序 -> 小端字节序
+inline uint16_t DS_HTOLES(uint16_t u16) { return DS_BSWAP16(u16); }
+inline uint32_t DS_HTOLEL(uint32_t u32) { return DS_BSWAP32(u32); }
+inline uint64_t DS_HTOLELL(uint64_t u64) { return DS_BSWAP64(u64); }
+inline void DS_HTOLES_N(void * pDst, const void * pSrc, size_t nCount) { DS_BSWAP16_N(pDst, pSrc, nCount); }
+inline void DS_HTOLEL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BSWAP32_N(pDst, pSrc, nCount); }
+inline void DS_HTOLELL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BSWAP64_N(pDst, pSrc, nCount); }
+
+#else
+
+// 本地字节序 -> 网络字节序(大端)
+inline uint16_t DS_HTONS(uint16_t u16) { return DS_BSWAP16(u16); }
+inline uint32_t DS_HTONL(uint32_t u32) { return DS_BSWAP32(u32); }
+inline uint64_t DS_HTONLL(uint64_t u64) { return DS_BSWAP64(u64); }
+inline void DS_HTONS_N(void * pDst, const void * pSrc, size_t nCount) { DS_BSWAP16_N(pDst, pSrc, nCount); }
+inline void DS_HTONL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BSWAP32_N(pDst, pSrc, nCount); }
+inline void DS_HTONLL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BSWAP64_N(pDst, pSrc, nCount); }
+
+// 本地字节序 -> 小端字节序
+inline uint16_t DS_HTOLES(uint16_t u16) { return u16; }
+inline uint32_t DS_HTOLEL(uint32_t u32) { return u32; }
+inline uint64_t DS_HTOLELL(uint64_t u64) { return u64; }
+inline void DS_HTOLES_N(void * pDst, const void * pSrc, size_t nCount) { DS_BCOPY_N(pDst, pSrc, nCount * 2); }
+inline void DS_HTOLEL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BCOPY_N(pDst, pSrc, nCount * 4); }
+inline void DS_HTOLELL_N(void * pDst, const void * pSrc, size_t nCount) { DS_BCOPY_N(pDst, pSrc, nCount * 8); }
+
+#endif
+
 // 网络字节序 -> 本地字节序
 #define DS_NTOHS DS_HTONS
 #define DS_NTOHL DS_HTONL
 #define DS_NTOHLL DS_HTONLL
+#define DS_NTOHS_N DS_HTONS_N
+#define DS_NTOHL_N DS_HTONL_N
+#define DS_NTOHLL_N DS_HTONLL_N
+
+// 小端字节序 -> 本地字节序
+#define DS_LETOHS DS_HTOLES
+#define DS_LETOHL DS_HTOLEL
+#define DS_LETOHLL DS_HTOLELL
+#define DS_LETOHS_N DS_HTOLES_N
+#define DS_LETOHL_N DS_HTOLEL_N
+#define DS_LETOHLL_N DS_HTOLELL_N
+
+// 线上字节序策略 =>
+// 默认采用大端(网络字节序)，与已有数据格式兼容；
+// 只在内部集群间通信时，可在所有编译单元中统一定义DS_WIRE_LITTLE_ENDIAN改用小端，x86等小端主机即可免去字节交换；
+// 转换是对称的，本地->线上与线上->本地使用同一函数
+
+struct SWireOrder_BigEndian
+{
+    static uint16_t conv16(uint16_t u16) { return DS_HTONS(u16); }
+    static uint32_t conv32(uint32_t u32) { return DS_HTONL(u32); }
+    static uint64_t conv64(uint64_t u64) { return DS_HTONLL(u64); }
+    static void conv16_n(void * pDst, const void * pSrc, size_t nCount) { DS_HTONS_N(pDst, pSrc, nCount); }
+    static void conv32_n(void * pDst, const void * pSrc, size_t nCount) { DS_HTONL_N(pDst, pSrc, nCount); }
+    static void conv64_n(void * pDst, const void * pSrc, size_t nCount) { DS_HTONLL_N(pDst, pSrc, nCount); }
+};
+
+struct SWireOrder_LittleEndian
+{
+    static uint16_t conv16(uint16_t u16) { return DS_HTOLES(u16); }
+    static uint32_t conv32(uint32_t u32) { return DS_HTOLEL(u32); }
+    static uint64_t conv64(uint64_t u64) { return DS_HTOLELL(u64); }
+    static void conv16_n(void * pDst, const void * pSrc, size_t nCount) { DS_HTOLES_N(pDst, pSrc, nCount); }
+    static void conv32_n(void * pDst, const void * pSrc, size_t nCount) { DS_HTOLEL_N(pDst, pSrc, nCount); }
+    static void conv64_n(void * pDst, const void * pSrc, size_t nCount) { DS_HTOLELL_N(pDst, pSrc, nCount); }
+};
+
+#ifdef DS_WIRE_LITTLE_ENDIAN
+typedef SWireOrder_LittleEndian DSWireOrder;
+#else
+typedef SWireOrder_BigEndian DSWireOrder;
+#endif
+
+// zigzag编码，把绝对值小的有符号数映射为小的无符号数，便于varint压缩
+inline uint64_t DS_ZIGZAG_ENCODE(int64_t i64) { return (uint64_t(i64) << 1) ^ uint64_t(i64 >> 63); }
+inline int64_t DS_ZIGZAG_DECODE(uint64_t u64) { return int64_t((u64 >> 1) ^ (~(u64 & 1) + 1)); }
 
 // 定义异常类型
 struct DSError
@@ -41,15 +217,42 @@ struct DSError
     DSError(const std::string & w) : std::runtime_error(w) {}
 };
 
+// 压包缓冲区的扩容策略，默认按2倍扩容
+#ifndef DS_PACKBUFFER_GROWTH_POLICY
+#define DS_PACKBUFFER_GROWTH_POLICY GROWTH_2X
+#endif
+
 // 定义压包缓冲区
 class DSPackBuffer
 {
 private:
     // 最大1G的压包缓冲区
-    typedef DSBuffer<BLOCK_ALLOC_4K, 1024 * 256> DSBuffer_t;
+    typedef DSBuffer<BLOCK_ALLOC_4K, 1024 * 256, DS_PACKBUFFER_GROWTH_POLICY> DSBuffer_t;
     DSBuffer_t m_buffer;
 
 public:
+    DSPackBuffer() {}
+
+#if __cplusplus >= 201103L
+    DSPackBuffer(DSPackBuffer && o) : m_buffer(std::move(o.m_buffer)) {}
+    DSPackBuffer & operator = (DSPackBuffer && o)
+    {
+        m_buffer = std::move(o.m_buffer);
+        return *this;
+    }
+#endif
+
+    void swap(DSPackBuffer & o)
+    {
+        m_buffer.swap(o.m_buffer);
+    }
+
+    // 交出内存块的所有权，用于将压包结果零复制地移交给其它线程
+    DSBufferBlock release()
+    {
+        return m_buffer.release();
+    }
+
     char * data()
     {
         return m_buffer.data();
@@ -90,54 +293,688 @@ public:
 
         throw DSError("[DSPackBuffer::replace] replace buffer overflow");
     }
+
+    // 直接写入reserve()后的尾部空闲空间，再用commit()提交写入的长度
+    char * tail()
+    {
+        return m_buffer.tail();
+    }
+
+    void commit(size_t nSize)
+    {
+        if (m_buffer.commit(nSize))
+            return;
+
+        throw DSError("[DSPackBuffer::commit] commit buffer overflow");
+    }
+
+    // 从头部消费已发送的数据，只推进读位置，用作发送队列时不必每次搬移
+    void consume(size_t nSize)
+    {
+        m_buffer.consume(nSize);
+    }
+};
+
+// 定义压包输出接口，使DSPack可以写入DSPackBuffer以外的缓冲区
+struct DSPackSink
+{
+    DSPackSink() : m_nReservePos(0) {}
+    virtual ~DSPackSink() {}
+
+    // 数据连续存放时返回数据指针，否则返回NULL
+    virtual const char * data() const { return NULL; }
+    virtual size_t size() const = 0;
+
+    virtual void resize(size_t nSize) = 0;
+    virtual void append(const char * pData, size_t nSize) = 0;
+    virtual void replace(size_t nPos, const char * pData, size_t nSize) = 0;
+
+    // 只计算长度而不保存数据(如DSSizeSink)时返回true，DSPack的批量写入据此直接累加长度
+    virtual bool size_only() const { return false; }
+
+    // 追加调用者持有的数据，默认复制；支持引用的缓冲区可以只记录地址
+    virtual void append_ref(const char * pData, size_t nSize)
+    {
+        append(pData, nSize);
+    }
+
+    // 预留尾部nSize字节的连续空间，返回写入地址，写完后用commit_tail()提交；
+    // 默认先扩充长度并写入临时区，提交时再替换回去，因此提交时不会再分配内存
+    virtual char * reserve_tail(size_t nSize)
+    {
+        m_nReservePos = size();
+        resize(m_nReservePos + nSize);
+
+        m_strScratch.resize(nSize);
+        return (nSize > 0 ? &m_strScratch[0] : NULL);
+    }
+    virtual void commit_tail(size_t nSize)
+    {
+        replace(m_nReservePos, m_strScratch.data(), nSize);
+        resize(m_nReservePos + nSize);
+    }
+
+protected:
+    size_t m_nReservePos;
+    std::string m_strScratch;
+};
+
+// 定义分段压包缓冲区，扩容时不搬移已写入的数据，可导出为iovec直接发送
+class DSChainPackBuffer
+        : public DSPackSink
+{
+private:
+    // 最大1G的压包缓冲区
+    typedef DSChainBuffer<BLOCK_ALLOC_4K, 1024 * 256> DSChainBuffer_t;
+    DSChainBuffer_t m_buffer;
+
+public:
+    virtual size_t size() const
+    {
+        return m_buffer.size();
+    }
+
+    virtual void resize(size_t nSize)
+    {
+        if (m_buffer.resize(nSize))
+            return;
+
+        throw DSError("[DSChainPackBuffer::resize] resize buffer overflow");
+    }
+
+    virtual void append(const char * pData, size_t nSize)
+    {
+        if (m_buffer.append(pData, nSize))
+            return;
+
+        throw DSError("[DSChainPackBuffer::append] append buffer overflow");
+    }
+
+    virtual void replace(size_t nPos, const char * pData, size_t nSize)
+    {
+        if (m_buffer.replace(nPos, pData, nSize))
+            return;
+
+        throw DSError("[DSChainPackBuffer::replace] replace buffer overflow");
+    }
+
+    void clear()
+    {
+        m_buffer.clear();
+    }
+
+    size_t iovecCount() const
+    {
+        return m_buffer.iovecCount();
+    }
+    size_t exportIovec(struct iovec * pIov, size_t nIovCount) const
+    {
+        return m_buffer.exportIovec(pIov, nIovCount);
+    }
+
+    size_t copyTo(char * pDst, size_t nPos = 0, size_t nSize = size_t(-1)) const
+    {
+        return m_buffer.copyTo(pDst, nPos, nSize);
+    }
+    void copyTo(std::string & str) const
+    {
+        str.resize(m_buffer.size());
+        if (!str.empty())
+            m_buffer.copyTo(&str[0]);
+    }
+};
+
+// 定义分散聚集压包缓冲区，不小于阈值的字符串与数据块只记录地址而不复制，与复制的小字段交错组成iovec，
+// 可直接用writev()/sendmsg()发送，也可以用copyTo()合并为连续数据；
+// 被引用的数据由调用者保证在发送或合并完成之前有效且不被修改，被引用的区域不能replace()
+class DSGatherPackBuffer
+        : public DSPackSink
+{
+private:
+    struct SRef
+    {
+        size_t nPos;    // 在本地数据中的插入位置
+        const char * pData;
+        size_t nSize;
+    };
+
+    // 最大1G的本地数据
+    typedef DSBuffer<BLOCK_ALLOC_4K, 1024 * 256, GROWTH_2X> DSBuffer_t;
+    DSBuffer_t m_buffer;
+    std::vector<SRef> m_vecRef;
+    size_t m_nRefSize;
+    size_t m_nRefThreshold;
+
+    DSGatherPackBuffer(const DSGatherPackBuffer & o);
+    DSGatherPackBuffer & operator = (const DSGatherPackBuffer & o);
+
+public:
+    explicit DSGatherPackBuffer(size_t nRefThreshold = 4096)
+        : m_nRefSize(0)
+        , m_nRefThreshold(nRefThreshold)
+    {
+    }
+
+    // 没有引用外部数据时数据是连续的
+    virtual const char * data() const
+    {
+        return (m_vecRef.empty() ? m_buffer.data() : NULL);
+    }
+    virtual size_t size() const
+    {
+        return m_buffer.size() + m_nRefSize;
+    }
+
+    size_t refCount() const { return m_vecRef.size(); }
+    size_t refSize() const { return m_nRefSize; }
+
+    virtual void resize(size_t nSize)
+    {
+        // 截断时丢弃或缩短被截掉的引用
+        while (!m_vecRef.empty())
+        {
+            SRef & ref = m_vecRef.back();
+            size_t nStart = ref.nPos + m_nRefSize - ref.nSize;
+            if (nSize >= nStart + ref.nSize)
+                break;
+
+            m_nRefSize -= ref.nSize;
+            if (nSize > nStart)
+            {
+                ref.nSize = nSize - nStart;
+                m_nRefSize += ref.nSize;
+                break;
+            }
+            m_vecRef.pop_back();
+        }
+
+        if (m_buffer.resize(nSize - m_nRefSize))
+            return;
+
+        throw DSError("[DSGatherPackBuffer::resize] resize buffer overflow");
+    }
+
+    virtual void append(const char * pData, size_t nSize)
+    {
+        if (m_buffer.append(pData, nSize))
+            return;
+
+        throw DSError("[DSGatherPackBuffer::append] append buffer overflow");
+    }
+
+    virtual void append_ref(const char * pData, size_t nSize)
+    {
+        if (nSize == 0 || nSize < m_nRefThreshold)
+            return append(pData, nSize);
+
+        SRef ref;
+        ref.nPos = m_buffer.size();
+        ref.pData = pData;
+        ref.nSize = nSize;
+        m_vecRef.push_back(ref);
+        m_nRefSize += nSize;
+    }
+
+    virtual void replace(size_t nPos, const char * pData, size_t nSize)
+    {
+        // 换算为本地数据中的位置
+        size_t nRefSize = 0;
+        for (size_t i = 0; i < m_vecRef.size(); ++i)
+        {
+            const SRef & ref = m_vecRef[i];
+            size_t nStart = ref.nPos + nRefSize;
+            if (nPos + nSize <= nStart)
+                break;
+            if (nPos < nStart + ref.nSize)
+                throw DSError("[DSGatherPackBuffer::replace] can not replace referenced data");
+
+            nRefSize += ref.nSize;
+        }
+
+        if (m_buffer.replace(nPos - nRefSize, pData, nSize))
+            return;
+
+        throw DSError("[DSGatherPackBuffer::replace] replace buffer overflow");
+    }
+
+    virtual char * reserve_tail(size_t nSize)
+    {
+        if (!m_buffer.reserve(m_buffer.size() + nSize))
+            throw DSError("[DSGatherPackBuffer::reserve_tail] reserve buffer overflow");
+
+        return m_buffer.tail();
+    }
+    virtual void commit_tail(size_t nSize)
+    {
+        m_buffer.commit(nSize);
+    }
+
+    void clear()
+    {
+        m_buffer.resize(0);
+        m_vecRef.clear();
+        m_nRefSize = 0;
+    }
+
+    // 本地数据段与引用段交错排列
+    size_t iovecCount() const
+    {
+        size_t nCount = 0;
+        size_t nPos = 0;
+        for (size_t i = 0; i < m_vecRef.size(); ++i)
+        {
+            nCount += (m_vecRef[i].nPos > nPos ? 2 : 1);
+            nPos = m_vecRef[i].nPos;
+        }
+        return nCount + (m_buffer.size() > nPos ? 1 : 0);
+    }
+    size_t exportIovec(struct iovec * pIov, size_t nIovCount) const
+    {
+        size_t nCount = 0;
+        size_t nPos = 0;
+        for (size_t i = 0; i < m_vecRef.size() && nCount < nIovCount; ++i)
+        {
+            const SRef & ref = m_vecRef[i];
+            if (ref.nPos > nPos)
+            {
+                pIov[nCount].iov_base = (void *)(m_buffer.data() + nPos);
+                pIov[nCount].iov_len = ref.nPos - nPos;
+                if (++nCount == nIovCount)
+                    return nCount;
+            }
+
+            pIov[nCount].iov_base = (void *)ref.pData;
+            pIov[nCount].iov_len = ref.nSize;
+            ++nCount;
+            nPos = ref.nPos;
+        }
+
+        if (m_buffer.size() > nPos && nCount < nIovCount)
+        {
+            pIov[nCount].iov_base = (void *)(m_buffer.data() + nPos);
+            pIov[nCount].iov_len = m_buffer.size() - nPos;
+            ++nCount;
+        }
+
+        return nCount;
+    }
+
+    // 合并为连续数据，pDst至少需要size()字节
+    size_t copyTo(char * pDst) const
+    {
+        size_t nPos = 0;
+        char * pCur = pDst;
+        for (size_t i = 0; i < m_vecRef.size(); ++i)
+        {
+            const SRef & ref = m_vecRef[i];
+            if (ref.nPos > nPos)
+            {
+                memcpy(pCur, m_buffer.data() + nPos, ref.nPos - nPos);
+                pCur += ref.nPos - nPos;
+            }
+            memcpy(pCur, ref.pData, ref.nSize);
+            pCur += ref.nSize;
+            nPos = ref.nPos;
+        }
+        if (m_buffer.size() > nPos)
+        {
+            memcpy(pCur, m_buffer.data() + nPos, m_buffer.size() - nPos);
+            pCur += m_buffer.size() - nPos;
+        }
+
+        return pCur - pDst;
+    }
+    void copyTo(std::string & str) const
+    {
+        str.resize(size());
+        if (!str.empty())
+            copyTo(&str[0]);
+    }
+};
+
+// 定义基于匿名内存映射的压包缓冲区，最大4G，用于构造数百M以上的数据包；
+// 扩容时通过mremap重新映射而不复制数据，物理内存随写入逐页分配，避免扩容时的内存峰值与长时间停顿
+template <typename BlockAllocator = BLOCK_ALLOC_MMAP>
+class DSHugePackBufferT
+        : public DSPackSink
+{
+private:
+    typedef DSBuffer<BlockAllocator, 1024 * 1024, GROWTH_2X> DSBuffer_t;
+    DSBuffer_t m_buffer;
+
+public:
+    virtual const char * data() const
+    {
+        return m_buffer.data();
+    }
+    virtual size_t size() const
+    {
+        return m_buffer.size();
+    }
+
+    void reserve(size_t nSize)
+    {
+        if (m_buffer.reserve(nSize))
+            return;
+
+        throw DSError("[DSHugePackBuffer::reserve] reserve buffer overflow");
+    }
+
+    virtual void resize(size_t nSize)
+    {
+        if (m_buffer.resize(nSize))
+            return;
+
+        throw DSError("[DSHugePackBuffer::resize] resize buffer overflow");
+    }
+
+    virtual void append(const char * pData, size_t nSize)
+    {
+        if (m_buffer.append(pData, nSize))
+            return;
+
+        throw DSError("[DSHugePackBuffer::append] append buffer overflow");
+    }
+
+    virtual void replace(size_t nPos, const char * pData, size_t nSize)
+    {
+        if (m_buffer.replace(nPos, pData, nSize))
+            return;
+
+        throw DSError("[DSHugePackBuffer::replace] replace buffer overflow");
+    }
+
+    virtual char * reserve_tail(size_t nSize)
+    {
+        reserve(m_buffer.size() + nSize);
+        return m_buffer.tail();
+    }
+    virtual void commit_tail(size_t nSize)
+    {
+        m_buffer.commit(nSize);
+    }
+
+    // 交出内存块的所有权，调用者需通过DSBufferBlock::deallocate()释放
+    DSBufferBlock release()
+    {
+        return m_buffer.release();
+    }
+};
+
+typedef DSHugePackBufferT<> DSHugePackBuffer;
+
+// 定义直接写入std::string的压包缓冲区，压包结果无需再复制
+class DSStringPackBuffer
+        : public DSPackSink
+{
+private:
+    std::string & m_str;
+
+    DSStringPackBuffer(const DSStringPackBuffer & o);
+    DSStringPackBuffer & operator = (const DSStringPackBuffer & o);
+
+public:
+    DSStringPackBuffer(std::string & str) : m_str(str) {}
+
+    virtual const char * data() const
+    {
+        return m_str.data();
+    }
+    virtual size_t size() const
+    {
+        return m_str.size();
+    }
+
+    virtual void resize(size_t nSize)
+    {
+        m_str.resize(nSize);
+    }
+
+    virtual void append(const char * pData, size_t nSize)
+    {
+        m_str.append(pData, nSize);
+    }
+
+    virtual void replace(size_t nPos, const char * pData, size_t nSize)
+    {
+        if (nPos >= m_str.size())
+            m_str.append(pData, nSize);
+        else
+            m_str.replace(nPos, nSize, pData, nSize);
+    }
+
+    virtual char * reserve_tail(size_t nSize)
+    {
+        m_nReservePos = m_str.size();
+        m_str.resize(m_nReservePos + nSize);
+        return (nSize > 0 ? &m_str[m_nReservePos] : NULL);
+    }
+    virtual void commit_tail(size_t nSize)
+    {
+        m_str.resize(m_nReservePos + nSize);
+    }
 };
 
 // 定义序列化操作类
 class DSPack
 {
 private:
-    DSPackBuffer & m_buffer;
+    DSPackBuffer * m_pBuffer;
+    DSPackSink * m_pSink;
     size_t m_offset;
+    bool m_bCompact;
+    bool m_bSizeOnly;
 
     DSPack (const DSPack & o);
     DSPack & operator = (const DSPack& o);
 
+    // 只计算长度时批量数据直接累加长度，不必经由临时区转换字节序
+    bool __skip_block(size_t nSize)
+    {
+        if (!m_bSizeOnly)
+            return false;
+
+        m_pSink->resize(m_pSink->size() + nSize);
+        return true;
+    }
+
 public:
-    static uint16_t xhtons(uint16_t u16) { return DS_HTONS(u16); }
-    static uint32_t xhtonl(uint32_t u32) { return DS_HTONL(u32); }
-    static uint64_t xhtonll(uint64_t u64) { return DS_HTONLL(u64); }
+    static uint16_t xhtons(uint16_t u16) { return DSWireOrder::conv16(u16); }
+    static uint32_t xhtonl(uint32_t u32) { return DSWireOrder::conv32(u32); }
+    static uint64_t xhtonll(uint64_t u64) { return DSWireOrder::conv64(u64); }
 
     DSPack(DSPackBuffer & pb, size_t off = 0)
-        : m_buffer(pb)
+        : m_pBuffer(&pb)
+        , m_pSink(NULL)
+        , m_bCompact(false)
+        , m_bSizeOnly(false)
     {
         m_offset = pb.size() + off;
-        m_buffer.resize(m_offset);
+        m_pBuffer->resize(m_offset);
+    }
+    DSPack(DSPackSink & sink, size_t off = 0)
+        : m_pBuffer(NULL)
+        , m_pSink(&sink)
+        , m_bCompact(false)
+        , m_bSizeOnly(sink.size_only())
+    {
+        m_offset = sink.size() + off;
+        m_pSink->resize(m_offset);
     }
     virtual ~DSPack() {}
 
-    const char * data() const { return m_buffer.data() + m_offset; }
-    size_t size() const { return m_buffer.size() - m_offset; }
+    // 写入非连续缓冲区时返回NULL；只计算长度(如DSSizer)时没有数据，抛出DSError
+    const char * data() const
+    {
+        if (m_bSizeOnly)
+            throw DSError("[DSPack::data] no data in size-only pack");
+
+        if (m_pBuffer != NULL)
+            return m_pBuffer->data() + m_offset;
+
+        const char * pData = m_pSink->data();
+        return (pData != NULL ? pData + m_offset : NULL);
+    }
+    size_t size() const { return (m_pBuffer != NULL ? m_pBuffer->size() : m_pSink->size()) - m_offset; }
+
+    // 是否只计算长度而不保存数据，marshal()可据此跳过代价高的写入过程，只累加长度
+    bool size_only() const { return m_bSizeOnly; }
+
+    // 紧凑模式：16/32/64位整数(包括字符串长度与容器元素个数)按varint压入，有符号数先做zigzag编码；
+    // 解包时DSUnpack也必须开启紧凑模式；replace_*与Reserved写入器不受影响，仍按定长写入
+    void set_compact(bool bCompact) { m_bCompact = bCompact; }
+    bool compact() const { return m_bCompact; }
 
     DSPack & push(const void * pData, size_t nSize)
     {
-        m_buffer.append((const char *)pData, nSize);
+        if (m_pBuffer != NULL)
+            m_pBuffer->append((const char *)pData, nSize);
+        else
+            m_pSink->append((const char *)pData, nSize);
         return *this;
     }
 
     DSPack & push_uint8(uint8_t u8) { return push(&u8, 1); }
-    DSPack & push_uint16(uint16_t u16) { u16 = xhtons(u16); return push(&u16, 2); }
-    DSPack & push_uint32(uint32_t u32) { u32 = xhtonl(u32); return push(&u32, 4); }
-    DSPack & push_uint64(uint64_t u64) { u64 = xhtonll(u64); return push(&u64, 8); }
+    DSPack & push_uint16(uint16_t u16) { if (m_bCompact) return push_varint(u16); u16 = xhtons(u16); return push(&u16, 2); }
+    DSPack & push_uint32(uint32_t u32) { if (m_bCompact) return push_varint(u32); u32 = xhtonl(u32); return push(&u32, 4); }
+    DSPack & push_uint64(uint64_t u64) { if (m_bCompact) return push_varint(u64); u64 = xhtonll(u64); return push(&u64, 8); }
+
+    DSPack & push_int16(int16_t i16) { return (m_bCompact ? push_varint(DS_ZIGZAG_ENCODE(i16)) : push_uint16(uint16_t(i16))); }
+    DSPack & push_int32(int32_t i32) { return (m_bCompact ? push_varint(DS_ZIGZAG_ENCODE(i32)) : push_uint32(uint32_t(i32))); }
+    DSPack & push_int64(int64_t i64) { return (m_bCompact ? push_varint(DS_ZIGZAG_ENCODE(i64)) : push_uint64(uint64_t(i64))); }
+
+    // 浮点数按位复制为同宽度的整数后转换字节序，总是定长，不受紧凑模式影响
+    DSPack & push_float(float f) { uint32_t u32; memcpy(&u32, &f, 4); u32 = xhtonl(u32); return push(&u32, 4); }
+    DSPack & push_double(double d) { uint64_t u64; memcpy(&u64, &d, 8); u64 = xhtonll(u64); return push(&u64, 8); }
+
+    // 按LEB128格式压入变长整数，每字节7位，最高位表示后面还有字节
+    DSPack & push_varint(uint64_t u64)
+    {
+        uint8_t buf[10];
+        size_t n = 0;
+        for (; u64 >= 0x80; u64 >>= 7)
+            buf[n++] = uint8_t(u64) | 0x80;
+        buf[n++] = uint8_t(u64);
+        return push(buf, n);
+    }
+
+    // 批量压入整型数组，一次预留空间并批量转换字节序
+    DSPack & push_uint16_array(const uint16_t * pData, size_t nCount)
+    {
+        if (m_bCompact)
+        {
+            for (size_t i = 0; i < nCount; ++i)
+                push_varint(pData[i]);
+            return *this;
+        }
+
+        if (__skip_block(nCount * 2))
+            return *this;
+
+        DSWireOrder::conv16_n(reserve_block(nCount * 2), pData, nCount);
+        commit_block(nCount * 2);
+        return *this;
+    }
+    DSPack & push_uint32_array(const uint32_t * pData, size_t nCount)
+    {
+        if (m_bCompact)
+        {
+            for (size_t i = 0; i < nCount; ++i)
+                push_varint(pData[i]);
+            return *this;
+        }
+
+        if (__skip_block(nCount * 4))
+            return *this;
+
+        DSWireOrder::conv32_n(reserve_block(nCount * 4), pData, nCount);
+        commit_block(nCount * 4);
+        return *this;
+    }
+    DSPack & push_uint64_array(const uint64_t * pData, size_t nCount)
+    {
+        if (m_bCompact)
+        {
+            for (size_t i = 0; i < nCount; ++i)
+                push_varint(pData[i]);
+            return *this;
+        }
+
+        if (__skip_block(nCount * 8))
+            return *this;
+
+        DSWireOrder::conv64_n(reserve_block(nCount * 8), pData, nCount);
+        commit_block(nCount * 8);
+        return *this;
+    }
+
+    DSPack & push_int16_array(const int16_t * pData, size_t nCount)
+    {
+        if (!m_bCompact)
+            return push_uint16_array((const uint16_t *)pData, nCount);
+
+        for (size_t i = 0; i < nCount; ++i)
+            push_varint(DS_ZIGZAG_ENCODE(pData[i]));
+        return *this;
+    }
+    DSPack & push_int32_array(const int32_t * pData, size_t nCount)
+    {
+        if (!m_bCompact)
+            return push_uint32_array((const uint32_t *)pData, nCount);
+
+        for (size_t i = 0; i < nCount; ++i)
+            push_varint(DS_ZIGZAG_ENCODE(pData[i]));
+        return *this;
+    }
+    DSPack & push_int64_array(const int64_t * pData, size_t nCount)
+    {
+        if (!m_bCompact)
+            return push_uint64_array((const uint64_t *)pData, nCount);
+
+        for (size_t i = 0; i < nCount; ++i)
+            push_varint(DS_ZIGZAG_ENCODE(pData[i]));
+        return *this;
+    }
+
+    DSPack & push_float_array(const float * pData, size_t nCount)
+    {
+        if (__skip_block(nCount * 4))
+            return *this;
+
+        DSWireOrder::conv32_n(reserve_block(nCount * 4), pData, nCount);
+        commit_block(nCount * 4);
+        return *this;
+    }
+    DSPack & push_double_array(const double * pData, size_t nCount)
+    {
+        if (__skip_block(nCount * 8))
+            return *this;
+
+        DSWireOrder::conv64_n(reserve_block(nCount * 8), pData, nCount);
+        commit_block(nCount * 8);
+        return *this;
+    }
+
+    // 压入调用者持有的数据，写入DSGatherPackBuffer等支持引用的缓冲区时可能只记录地址，
+    // 此时数据须在发送或合并完成之前保持有效
+    DSPack & push_ref(const void * pData, size_t nSize)
+    {
+        if (m_pBuffer != NULL)
+            m_pBuffer->append((const char *)pData, nSize);
+        else
+            m_pSink->append_ref((const char *)pData, nSize);
+        return *this;
+    }
 
     DSPack & push_string(const void * pData, size_t nSize)
     {
         if (nSize > 0xFFFF) throw DSError("[DSPack::push_string] string too big");
-        return push_uint16(uint16_t(nSize)).push(pData, nSize);
+        return push_uint16(uint16_t(nSize)).push_ref(pData, nSize);
     }
     DSPack & push_string32(const void * pData, size_t nSize)
     {
         if (nSize > 0xFFFFFFFF) throw DSError("[DSPack::push_string32] string too big");
-        return push_uint32(uint32_t(nSize)).push(pData, nSize);
+        return push_uint32(uint32_t(nSize)).push_ref(pData, nSize);
     }
 
     DSPack & push_string(const std::string & str) { return push_string(str.data(), str.size()); }
@@ -145,7 +982,10 @@ public:
 
     DSPack & replace(size_t nPos, const void * pData, size_t nSize)
     {
-        m_buffer.replace(nPos, (const char*)pData, nSize);
+        if (m_pBuffer != NULL)
+            m_pBuffer->replace(nPos, (const char*)pData, nSize);
+        else
+            m_pSink->replace(nPos, (const char*)pData, nSize);
         return *this;
     }
 
@@ -155,6 +995,191 @@ public:
     DSPack & replace_uint64(size_t nPos, uint64_t u64) { u64 = xhtonll(u64); return replace(nPos, &u64, 8); }
     DSPack & replace_string(size_t nPos, const void * pData, size_t nSize) { return replace_uint16(nPos, uint16_t(nSize)).replace(nPos + 2, pData, nSize); }
     DSPack & replace_string32(size_t nPos, const void * pData, size_t nSize) { return replace_uint32(nPos, uint32_t(nSize)).replace(nPos + 4, pData, nSize); }
+
+    // 预留尾部nSize字节的连续空间并返回写入地址，写完后需调用commit_block()提交实际写入的长度
+    char * reserve_block(size_t nSize)
+    {
+        if (m_pBuffer != NULL)
+        {
+            m_pBuffer->reserve(m_pBuffer->size() + nSize);
+            return m_pBuffer->tail();
+        }
+        return m_pSink->reserve_tail(nSize);
+    }
+    void commit_block(size_t nSize)
+    {
+        if (m_pBuffer != NULL)
+            m_pBuffer->commit(nSize);
+        else
+            m_pSink->commit_tail(nSize);
+    }
+
+    // 定义预留空间写入器，构造时一次性预留空间，之后的写入不再扩容，写完后用commit()提交写入的长度；
+    // 同一DSPack上不可嵌套使用，适合在marshal()中写入定长的包头
+    class Reserved
+    {
+    private:
+        DSPack & m_pack;
+        char * m_pBegin;
+        char * m_pCur;
+        char * m_pEnd;
+        bool m_bCommitted;
+
+        Reserved(const Reserved & o);
+        Reserved & operator = (const Reserved & o);
+
+    public:
+        Reserved(DSPack & pack, size_t nSize)
+            : m_pack(pack)
+            , m_bCommitted(false)
+        {
+            m_pBegin = m_pCur = pack.reserve_block(nSize);
+            m_pEnd = m_pBegin + nSize;
+        }
+        // 未调用commit()时在析构时补交，提交失败不会抛出，需要检查失败时应显式调用commit()
+        ~Reserved()
+        {
+            if (m_bCommitted)
+                return;
+
+            try
+            {
+                commit();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        // 提交写入的长度，可能抛出缓冲区的DSError
+        void commit()
+        {
+            if (m_bCommitted)
+                return;
+
+            m_bCommitted = true;
+            m_pack.commit_block(size());
+        }
+
+        size_t size() const { return m_pCur - m_pBegin; }
+        size_t left() const { return m_pEnd - m_pCur; }
+
+        // 长度由调用者给出，总是检查是否超出预留空间
+        Reserved & put(const void * pData, size_t nSize)
+        {
+            if (nSize > left()) throw DSError("[DSPack::Reserved::put] reserved space overflow");
+            return __put(pData, nSize);
+        }
+
+        // 定长字段的长度在预留时已计入，只在调试版本中检查
+        Reserved & put_uint8(uint8_t u8) { return __put(&u8, 1); }
+        Reserved & put_uint16(uint16_t u16) { u16 = xhtons(u16); return __put(&u16, 2); }
+        Reserved & put_uint32(uint32_t u32) { u32 = xhtonl(u32); return __put(&u32, 4); }
+        Reserved & put_uint64(uint64_t u64) { u64 = xhtonll(u64); return __put(&u64, 8); }
+        Reserved & put_float(float f) { uint32_t u32; memcpy(&u32, &f, 4); return put_uint32(u32); }
+        Reserved & put_double(double d) { uint64_t u64; memcpy(&u64, &d, 8); return put_uint64(u64); }
+
+        // 字符串的长度取决于数据，长度前缀与内容一起检查一次
+        Reserved & put_string(const void * pData, size_t nSize)
+        {
+            if (nSize > 0xFFFF) throw DSError("[DSPack::Reserved::put_string] string too big");
+            if (2 + nSize > left()) throw DSError("[DSPack::Reserved::put_string] reserved space overflow");
+            return put_uint16(uint16_t(nSize)).__put(pData, nSize);
+        }
+        Reserved & put_string32(const void * pData, size_t nSize)
+        {
+            if (nSize > 0xFFFFFFFF) throw DSError("[DSPack::Reserved::put_string32] string too big");
+            if (4 + nSize > left()) throw DSError("[DSPack::Reserved::put_string32] reserved space overflow");
+            return put_uint32(uint32_t(nSize)).__put(pData, nSize);
+        }
+
+    private:
+        Reserved & __put(const void * pData, size_t nSize)
+        {
+            assert(nSize <= left());
+            memcpy(m_pCur, pData, nSize);
+            m_pCur += nSize;
+            return *this;
+        }
+    };
+};
+
+// 定义只累计长度的压包接收端
+class DSSizeSink
+        : public DSPackSink
+{
+private:
+    size_t m_nSize;
+    char m_szScratch[256];
+
+public:
+    DSSizeSink() : m_nSize(0) {}
+
+    virtual bool size_only() const
+    {
+        return true;
+    }
+
+    virtual size_t size() const
+    {
+        return m_nSize;
+    }
+
+    virtual void resize(size_t nSize)
+    {
+        m_nSize = nSize;
+    }
+
+    virtual void append(const char *, size_t nSize)
+    {
+        m_nSize += nSize;
+    }
+
+    virtual void replace(size_t nPos, const char *, size_t nSize)
+    {
+        if (nPos + nSize > m_nSize)
+            m_nSize = nPos + nSize;
+    }
+
+    // 预留时直接累加长度，写入的内容丢弃；不超过256字节时写入内部的固定区，不分配内存
+    virtual char * reserve_tail(size_t nSize)
+    {
+        m_nReservePos = m_nSize;
+        m_nSize += nSize;
+        if (nSize <= sizeof(m_szScratch))
+            return m_szScratch;
+
+        m_strScratch.resize(nSize);
+        return &m_strScratch[0];
+    }
+    virtual void commit_tail(size_t nSize)
+    {
+        m_nSize = m_nReservePos + nSize;
+    }
+};
+
+struct DSSizeSinkHolder
+{
+    DSSizeSink m_sizeSink;
+};
+
+// 定义长度计算类，接受与DSPack相同的<<操作，只计算序列化后的长度而不写入数据
+class DSSizer
+        : private DSSizeSinkHolder
+        , public DSPack
+{
+public:
+    explicit DSSizer(bool bCompact = false) : DSPack(m_sizeSink) { set_compact(bCompact); }
+};
+
+// 定义解包错误码
+enum DSUnpackError
+{
+    DS_UNPACK_OK = 0,
+    DS_UNPACK_NOT_ENOUGH_DATA,
+    DS_UNPACK_TOO_MUCH_DATA,
+    DS_UNPACK_BAD_VARINT,
+    DS_UNPACK_BAD_VALUE
 };
 
 // 定义反序列化操作类
@@ -163,13 +1188,21 @@ class DSUnpack
 private:
     mutable const char * m_pData;
     mutable size_t m_nSize;
+    bool m_bCompact;
+    bool m_bNoThrow;
+    mutable int m_nError;
 
 public:
-    static uint16_t xntohs(uint16_t u16) { return DS_NTOHS(u16); }
-    static uint32_t xntohl(uint32_t u32) { return DS_NTOHL(u32); }
-    static uint64_t xntohll(uint64_t u64) { return DS_NTOHLL(u64); }
+    enum { zeroBlockSize = 4096 };
+
+    static uint16_t xntohs(uint16_t u16) { return DSWireOrder::conv16(u16); }
+    static uint32_t xntohl(uint32_t u32) { return DSWireOrder::conv32(u32); }
+    static uint64_t xntohll(uint64_t u64) { return DSWireOrder::conv64(u64); }
 
     DSUnpack(const void * pData, size_t nSize)
+        : m_bCompact(false)
+        , m_bNoThrow(false)
+        , m_nError(DS_UNPACK_OK)
     {
         reset(pData, nSize);
     }
@@ -192,16 +1225,42 @@ public:
 
     bool empty() const	  { return size() == 0; }
 
+    // 紧凑模式，与DSPack::set_compact()对应
+    void set_compact(bool bCompact) { m_bCompact = bCompact; }
+    bool compact() const { return m_bCompact; }
+
+    // 不抛异常模式：解包出错时不抛出DSError，而是记录首个错误码并丢弃剩余数据，
+    // 之后的解包都返回0值/空串/空容器，全部解完后通过ok()/error()检查结果
+    void set_nothrow(bool bNoThrow) { m_bNoThrow = bNoThrow; }
+    bool nothrow() const { return m_bNoThrow; }
+
+    bool ok() const { return m_nError == DS_UNPACK_OK; }
+    int error() const { return m_nError; }
+    void clear_error() const { m_nError = DS_UNPACK_OK; }
+
+    // 供自定义的反序列化报告数据错误，与内部错误的处理方式相同
+    void fail(int nError, const char * pWhat) const { __fail(nError, pWhat); }
+
     void finish() const
     {
         if (!empty())
-            throw DSError("[DSUnpack::finish] too much data");
+            __fail(DS_UNPACK_TOO_MUCH_DATA, "[DSUnpack::finish] too much data");
     }
 
+    // 检查剩余数据是否不少于nSize字节，用于一次性检查定长字段，之后再用Required无检查地读取
+    bool require(size_t nSize) const
+    {
+        if (m_nSize < nSize)
+            return (__fail(DS_UNPACK_NOT_ENOUGH_DATA, "[DSUnpack::require] not enough data"), false);
+
+        return true;
+    }
+
+    // 不抛异常模式下解包失败时返回零值区，只保证前zeroBlockSize字节可读
     const char * pop_fetch_ptr(size_t nSize, bool bPeek = false) const
     {
         if (m_nSize < nSize)
-            throw DSError("[DSUnpack::pop_fetch_ptr] not enough data");
+            return __fail(DS_UNPACK_NOT_ENOUGH_DATA, "[DSUnpack::pop_fetch_ptr] not enough data");
 
         const char * pData = m_pData;
 
@@ -214,32 +1273,178 @@ public:
         return pData;
     }
 
-    uint8_t pop_uint8(bool bPeek = false) const { return *(uint8_t*)pop_fetch_ptr(1, bPeek); }
-    uint16_t pop_uint16(bool bPeek = false) const { uint16_t u16 = *(uint16_t*)pop_fetch_ptr(2, bPeek); return xntohs(u16); }
-    uint32_t pop_uint32(bool bPeek = false) const { uint32_t u32 = *(uint32_t*)pop_fetch_ptr(4, bPeek); return xntohl(u32); }
-    uint64_t pop_uint64(bool bPeek = false) const { uint64_t u64 = *(uint64_t*)pop_fetch_ptr(8, bPeek); return xntohll(u64); }
+    // 数据可能不对齐，统一用memcpy读取
+    uint8_t pop_uint8(bool bPeek = false) const { return *(const uint8_t*)pop_fetch_ptr(1, bPeek); }
+    uint16_t pop_uint16(bool bPeek = false) const { if (m_bCompact) return uint16_t(pop_varint(0xFFFF, bPeek)); uint16_t u16; memcpy(&u16, pop_fetch_ptr(2, bPeek), 2); return xntohs(u16); }
+    uint32_t pop_uint32(bool bPeek = false) const { if (m_bCompact) return uint32_t(pop_varint(0xFFFFFFFF, bPeek)); uint32_t u32; memcpy(&u32, pop_fetch_ptr(4, bPeek), 4); return xntohl(u32); }
+    uint64_t pop_uint64(bool bPeek = false) const { if (m_bCompact) return pop_varint(uint64_t(-1), bPeek); uint64_t u64; memcpy(&u64, pop_fetch_ptr(8, bPeek), 8); return xntohll(u64); }
+
+    int16_t pop_int16() const { return (m_bCompact ? int16_t(DS_ZIGZAG_DECODE(pop_varint(0xFFFF))) : int16_t(pop_uint16())); }
+    int32_t pop_int32() const { return (m_bCompact ? int32_t(DS_ZIGZAG_DECODE(pop_varint(0xFFFFFFFF))) : int32_t(pop_uint32())); }
+    int64_t pop_int64() const { return (m_bCompact ? DS_ZIGZAG_DECODE(pop_varint(uint64_t(-1))) : int64_t(pop_uint64())); }
+
+    // 浮点数总是定长，与DSPack::push_float()/push_double()对应
+    float pop_float(bool bPeek = false) const { uint32_t u32; memcpy(&u32, pop_fetch_ptr(4, bPeek), 4); u32 = xntohl(u32); float f; memcpy(&f, &u32, 4); return f; }
+    double pop_double(bool bPeek = false) const { uint64_t u64; memcpy(&u64, pop_fetch_ptr(8, bPeek), 8); u64 = xntohll(u64); double d; memcpy(&d, &u64, 8); return d; }
+
+    // 解出LEB128格式的变长整数，超过u64Max时抛出异常
+    uint64_t pop_varint(uint64_t u64Max = uint64_t(-1), bool bPeek = false) const
+    {
+        const uint8_t * p = (const uint8_t *)m_pData;
+        uint64_t u64 = 0;
+        size_t n = 0;
+
+        // 单字节最常见
+        if (m_nSize > 0 && p[0] < 0x80)
+        {
+            u64 = p[0];
+            n = 1;
+        }
+#if defined(__GNUC__) && !defined(DS_HOST_BIG_ENDIAN)
+        // 剩余数据不少于8字节时，一次读入8字节，用结束位定位长度后并行拼接各字节的低7位
+        else if (m_nSize >= 8)
+        {
+            uint64_t u64Word;
+            memcpy(&u64Word, p, 8);
+
+            uint64_t u64Stop = ~u64Word & 0x8080808080808080ULL;
+            if (u64Stop != 0)
+            {
+                n = (__builtin_ctzll(u64Stop) >> 3) + 1;
+                uint64_t u64Mask = (n == 8 ? 0x7F7F7F7F7F7F7F7FULL : (0x7F7F7F7F7F7F7F7FULL & ((1ULL << (n * 8)) - 1)));
+#if defined(__BMI2__)
+                u64 = _pext_u64(u64Word, u64Mask);
+#else
+                u64 = u64Word & u64Mask;
+                u64 = ((u64 & 0x7F007F007F007F00ULL) >> 1) | (u64 & 0x007F007F007F007FULL);
+                u64 = ((u64 & 0x3FFF00003FFF0000ULL) >> 2) | (u64 & 0x00003FFF00003FFFULL);
+                u64 = ((u64 & 0x0FFFFFFF00000000ULL) >> 4) | (u64 & 0x000000000FFFFFFFULL);
+#endif
+            }
+        }
+#endif
+        // 逐字节解析
+        if (n == 0)
+        {
+            for (unsigned int nShift = 0; ; nShift += 7)
+            {
+                if (n >= m_nSize)
+                    return (__fail(DS_UNPACK_NOT_ENOUGH_DATA, "[DSUnpack::pop_varint] not enough data"), 0);
+                if (n >= 10)
+                    return (__fail(DS_UNPACK_BAD_VARINT, "[DSUnpack::pop_varint] varint too long"), 0);
+
+                uint8_t u8 = p[n++];
+                u64 |= uint64_t(u8 & 0x7F) << nShift;
+                if (u8 < 0x80)
+                    break;
+            }
+        }
+
+        if (u64 > u64Max)
+            return (__fail(DS_UNPACK_BAD_VARINT, "[DSUnpack::pop_varint] varint overflow"), 0);
+
+        pop_fetch_ptr(n, bPeek);
+        return u64;
+    }
+
+    // 批量解出整型数组
+    void pop_uint16_array(uint16_t * pData, size_t nCount) const
+    {
+        if (!m_bCompact)
+            return __conv_array(DSWireOrder::conv16_n, pData, nCount, 2);
+
+        for (size_t i = 0; i < nCount; ++i)
+            pData[i] = pop_uint16();
+    }
+    void pop_uint32_array(uint32_t * pData, size_t nCount) const
+    {
+        if (!m_bCompact)
+            return __conv_array(DSWireOrder::conv32_n, pData, nCount, 4);
+
+        for (size_t i = 0; i < nCount; ++i)
+            pData[i] = pop_uint32();
+    }
+    void pop_uint64_array(uint64_t * pData, size_t nCount) const
+    {
+        if (!m_bCompact)
+            return __conv_array(DSWireOrder::conv64_n, pData, nCount, 8);
+
+        for (size_t i = 0; i < nCount; ++i)
+            pData[i] = pop_uint64();
+    }
+    void pop_int16_array(int16_t * pData, size_t nCount) const
+    {
+        if (!m_bCompact)
+            return pop_uint16_array((uint16_t *)pData, nCount);
+
+        for (size_t i = 0; i < nCount; ++i)
+            pData[i] = pop_int16();
+    }
+    void pop_int32_array(int32_t * pData, size_t nCount) const
+    {
+        if (!m_bCompact)
+            return pop_uint32_array((uint32_t *)pData, nCount);
+
+        for (size_t i = 0; i < nCount; ++i)
+            pData[i] = pop_int32();
+    }
+    void pop_int64_array(int64_t * pData, size_t nCount) const
+    {
+        if (!m_bCompact)
+            return pop_uint64_array((uint64_t *)pData, nCount);
+
+        for (size_t i = 0; i < nCount; ++i)
+            pData[i] = pop_int64();
+    }
+    void pop_float_array(float * pData, size_t nCount) const
+    {
+        __conv_array(DSWireOrder::conv32_n, pData, nCount, 4);
+    }
+    void pop_double_array(double * pData, size_t nCount) const
+    {
+        __conv_array(DSWireOrder::conv64_n, pData, nCount, 8);
+    }
+
+    // 解出nCount个长度为nItemSize的元素，先检查长度以免乘法溢出
+    // 不抛异常模式下解包失败时返回NULL
+    const char * pop_fetch_array(size_t nCount, size_t nItemSize, bool bPeek = false) const
+    {
+        if (nCount > m_nSize / nItemSize)
+            return (__fail(DS_UNPACK_NOT_ENOUGH_DATA, "[DSUnpack::pop_fetch_array] not enough data"), (const char *)NULL);
+
+        return pop_fetch_ptr(nCount * nItemSize, bPeek);
+    }
+
+    void pop_uint8_array(uint8_t * pData, size_t nCount) const
+    {
+        const char * pSrc = pop_fetch_array(nCount, 1);
+        if (pSrc != NULL)
+            memcpy(pData, pSrc, nCount);
+        else
+            memset(pData, 0, nCount);
+    }
 
     const char * pop_string(size_t & nSize) const
     {
         nSize = pop_uint16();
-        return pop_fetch_ptr(nSize);
+        return __pop_sized(nSize);
     }
     const char * pop_string32(size_t & nSize) const
     {
         nSize = pop_uint32();
-        return pop_fetch_ptr(nSize);
+        return __pop_sized(nSize);
     }
 
     std::string pop_string() const
     {
         size_t nSize = pop_uint16();
-        const char* pData = pop_fetch_ptr(nSize);
+        const char* pData = __pop_sized(nSize);
         return std::string(pData, nSize);
     }
     std::string pop_string32() const
     {
         size_t nSize = pop_uint32();
-        const char* pData = pop_fetch_ptr(nSize);
+        const char* pData = __pop_sized(nSize);
         return std::string(pData, nSize);
     }
 
@@ -247,16 +1452,129 @@ public:
     {
         StringPtr SP;
         SP.m_nSize = pop_uint16();
-        SP.m_pData = pop_fetch_ptr(SP.m_nSize);
+        SP.m_pData = __pop_sized(SP.m_nSize);
         return SP;
     }
     StringPtr pop_StringPtr32() const
     {
         StringPtr SP;
         SP.m_nSize = pop_uint32();
-        SP.m_pData = pop_fetch_ptr(SP.m_nSize);
+        SP.m_pData = __pop_sized(SP.m_nSize);
         return SP;
     }
+
+    // 定义定长区读取器，构造时一次性检查nSize字节，之后的读取不再检查长度，析构时提交读取的长度；
+    // 总是按定长读取(与DSPack::Reserved对应)，使用期间不可再直接从DSUnpack解包，
+    // 适合在unmarshal()中先声明包头长度再逐个读取字段
+    class Required
+    {
+    private:
+        const DSUnpack & m_up;
+        const char * m_pBegin;
+        const char * m_pCur;
+        const char * m_pEnd;
+
+        Required(const Required & o);
+        Required & operator = (const Required & o);
+
+    public:
+        Required(const DSUnpack & up, size_t nSize)
+            : m_up(up)
+        {
+            // 检查失败时(不抛异常模式)读取零值区，长度不超过zeroBlockSize
+            m_pBegin = m_pCur = (up.require(nSize) ? up.data() : up.pop_fetch_ptr(nSize));
+            m_pEnd = m_pBegin + (up.ok() ? nSize : (nSize < zeroBlockSize ? nSize : size_t(zeroBlockSize)));
+        }
+        ~Required()
+        {
+            if (m_up.ok())
+                m_up.pop_fetch_ptr(size());
+        }
+
+        size_t size() const { return m_pCur - m_pBegin; }
+        size_t left() const { return m_pEnd - m_pCur; }
+
+        // 定长字段已由构造时检查，变长字段(如字符串的内容)的长度来自数据本身，需逐次检查
+        const char * get(size_t nSize)
+        {
+            if (nSize > left())
+            {
+                m_pCur = m_pEnd;
+                return m_up.__fail(DS_UNPACK_NOT_ENOUGH_DATA, "[DSUnpack::Required::get] not enough data");
+            }
+
+            const char * pData = m_pCur;
+            m_pCur += nSize;
+            return pData;
+        }
+
+        uint8_t get_uint8() { return *(const uint8_t *)get(1); }
+        uint16_t get_uint16() { uint16_t u16; memcpy(&u16, get(2), 2); return xntohs(u16); }
+        uint32_t get_uint32() { uint32_t u32; memcpy(&u32, get(4), 4); return xntohl(u32); }
+        uint64_t get_uint64() { uint64_t u64; memcpy(&u64, get(8), 8); return xntohll(u64); }
+        float get_float() { uint32_t u32 = get_uint32(); float f; memcpy(&f, &u32, 4); return f; }
+        double get_double() { uint64_t u64 = get_uint64(); double d; memcpy(&d, &u64, 8); return d; }
+
+        StringPtr get_StringPtr()
+        {
+            StringPtr SP;
+            SP.m_nSize = get_uint16();
+            SP.m_pData = get(SP.m_nSize);
+            // 失败时指向零值区，长度置0
+            if (!m_up.ok())
+                SP.m_nSize = 0;
+            return SP;
+        }
+
+        Required & operator >> (bool & b) { b = (get_uint8() != 0); return *this; }
+        Required & operator >> (uint8_t & u8) { u8 = get_uint8(); return *this; }
+        Required & operator >> (uint16_t & u16) { u16 = get_uint16(); return *this; }
+        Required & operator >> (uint32_t & u32) { u32 = get_uint32(); return *this; }
+        Required & operator >> (uint64_t & u64) { u64 = get_uint64(); return *this; }
+        Required & operator >> (int8_t & i8) { i8 = int8_t(get_uint8()); return *this; }
+        Required & operator >> (int16_t & i16) { i16 = int16_t(get_uint16()); return *this; }
+        Required & operator >> (int32_t & i32) { i32 = int32_t(get_uint32()); return *this; }
+        Required & operator >> (int64_t & i64) { i64 = int64_t(get_uint64()); return *this; }
+        Required & operator >> (float & f) { f = get_float(); return *this; }
+        Required & operator >> (double & d) { d = get_double(); return *this; }
+    };
+
+private:
+    // 记录错误，抛异常模式下直接抛出DSError
+    const char * __fail(int nError, const char * pWhat) const
+    {
+        if (!m_bNoThrow)
+            throw DSError(pWhat);
+
+        if (m_nError == DS_UNPACK_OK)
+            m_nError = nError;
+
+        // 丢弃剩余数据，之后的解包都会失败并返回0值
+        m_pData += m_nSize;
+        m_nSize = 0;
+
+        static const char s_zero[zeroBlockSize] = { 0 };
+        return s_zero;
+    }
+
+    // 解出变长数据，失败时长度置0
+    const char * __pop_sized(size_t & nSize) const
+    {
+        const char * pData = pop_fetch_ptr(nSize);
+        if (m_nError != DS_UNPACK_OK)
+            nSize = 0;
+        return pData;
+    }
+
+    template <typename Conv, typename T>
+    void __conv_array(Conv conv, T * pData, size_t nCount, size_t nItemSize) const
+    {
+        const char * pSrc = pop_fetch_array(nCount, nItemSize);
+        if (pSrc != NULL)
+            conv(pData, pSrc, nCount);
+        else
+            memset(pData, 0, nCount * nItemSize);
+    }
 };
 
 
@@ -294,25 +1612,37 @@ inline DSPack & operator << (DSPack & p, uint64_t u64)
 
 inline DSPack & operator << (DSPack & p, int8_t i8)
 {
-    p.push_uint8((uint8_t)i8);
+    p.push_uint8((uint8_t)i8);
+    return p;
+}
+
+inline DSPack & operator << (DSPack & p, int16_t i16)
+{
+    p.push_int16(i16);
+    return p;
+}
+
+inline DSPack & operator << (DSPack & p, int32_t i32)
+{
+    p.push_int32(i32);
     return p;
 }
 
-inline DSPack & operator << (DSPack & p, int16_t i16)
+inline DSPack & operator << (DSPack & p, int64_t i64)
 {
-    p.push_uint16((uint16_t)i16);
+    p.push_int64(i64);
     return p;
 }
 
-inline DSPack & operator << (DSPack & p, int32_t i32)
+inline DSPack & operator << (DSPack & p, float f)
 {
-    p.push_uint32((uint32_t)i32);
+    p.push_float(f);
     return p;
 }
 
-inline DSPack & operator << (DSPack & p, int64_t i64)
+inline DSPack & operator << (DSPack & p, double d)
 {
-    p.push_uint64((uint64_t)i64);
+    p.push_double(d);
     return p;
 }
 
@@ -366,19 +1696,31 @@ inline const DSUnpack & operator >> (const DSUnpack & up, int8_t & i8)
 
 inline const DSUnpack & operator >> (const DSUnpack & up, int16_t & i16)
 {
-    i16 = (int16_t)up.pop_uint16();
+    i16 = up.pop_int16();
     return up;
 }
 
 inline const DSUnpack & operator >> (const DSUnpack & up, int32_t & i32)
 {
-    i32 = (int32_t)up.pop_uint32();
+    i32 = up.pop_int32();
     return up;
 }
 
 inline const DSUnpack & operator >> (const DSUnpack & up, int64_t & i64)
 {
-    i64 = (int64_t)up.pop_uint64();
+    i64 = up.pop_int64();
+    return up;
+}
+
+inline const DSUnpack & operator >> (const DSUnpack & up, float & f)
+{
+    f = up.pop_float();
+    return up;
+}
+
+inline const DSUnpack & operator >> (const DSUnpack & up, double & d)
+{
+    d = up.pop_double();
     return up;
 }
 
@@ -396,6 +1738,13 @@ inline const DSUnpack & operator >> (const DSUnpack & up, StringPtr & SP)
 
 // 容器类型的序列化与反序列化 =>
 
+// 解出的临时对象移入容器，C++98下退化为复制
+#if __cplusplus >= 201103L
+#define DS_MOVE(x) std::move(x)
+#else
+#define DS_MOVE(x) (x)
+#endif
+
 template < typename ContainerClass >
 inline void marshal_container(DSPack & p, const ContainerClass & c)
 {
@@ -409,11 +1758,12 @@ inline void marshal_container(DSPack & p, const ContainerClass & c)
 template < typename OutputIterator >
 inline void unmarshal_container(const DSUnpack & up, OutputIterator i)
 {
-    for (uint32_t count = up.pop_uint32(); count > 0; --count)
+    // 不抛异常模式下出错后立即结束，避免按错误的元素个数空转
+    for (uint32_t count = up.pop_uint32(); count > 0 && up.ok(); --count)
     {
         typename OutputIterator::container_type::value_type tmp;
         up >> tmp;
-        *i = tmp;
+        *i = DS_MOVE(tmp);
         ++i;
     }
 }
@@ -421,14 +1771,52 @@ inline void unmarshal_container(const DSUnpack & up, OutputIterator i)
 template < typename OutputContainer >
 inline void unmarshal_container2(const DSUnpack & p, OutputContainer & c)
 {
-    for (uint32_t count = p.pop_uint32(); count > 0; --count)
+    for (uint32_t count = p.pop_uint32(); count > 0 && p.ok(); --count)
     {
         typename OutputContainer::value_type tmp;
         p >> tmp;
-        c.push_back(tmp);
+        c.push_back(DS_MOVE(tmp));
+    }
+}
+
+// 顺序容器先在尾部构造空元素，再直接解到元素上，省去临时对象
+template < typename OutputContainer >
+inline void unmarshal_sequence(const DSUnpack & up, OutputContainer & c, size_t count)
+{
+    for (; count > 0 && up.ok(); --count)
+    {
+#if __cplusplus >= 201103L
+        c.emplace_back();
+#else
+        c.push_back(typename OutputContainer::value_type());
+#endif
+        up >> c.back();
+    }
+}
+
+// 有序容器按序列化的顺序(即已排好序)出现，以end()为提示插入，总体为O(n)
+// ItemType为可写的元素类型，std::map的键为const，需用std::pair<K, V>解出后移入
+template < typename ItemType, typename OutputContainer >
+inline void unmarshal_ordered(const DSUnpack & up, OutputContainer & c)
+{
+    for (uint32_t count = up.pop_uint32(); count > 0 && up.ok(); --count)
+    {
+        ItemType tmp;
+        up >> tmp;
+#if __cplusplus >= 201103L
+        c.emplace_hint(c.end(), std::move(tmp));
+#else
+        c.insert(c.end(), tmp);
+#endif
     }
 }
 
+// 按元素个数预留空间时，每个元素至少占1字节，不超过剩余数据长度
+inline size_t unmarshal_reserve_count(const DSUnpack & up, size_t count)
+{
+    return (count < up.size() ? count : up.size());
+}
+
 template <class T1, class T2>
 inline DSPack & operator << (DSPack & p, const std::pair<T1, T2> & pair)
 {
@@ -461,11 +1849,89 @@ inline DSPack & operator << (DSPack & p, const std::vector<T> & vec)
 
 template <class T>
 inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<T> & vec)
+{
+    size_t count = up.pop_uint32();
+    vec.reserve(vec.size() + unmarshal_reserve_count(up, count));
+
+    unmarshal_sequence(up, vec, count);
+    return up;
+}
+
+// std::vector<bool>的元素不能取引用，仍经临时对象解出
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<bool> & vec)
 {
     unmarshal_container(up, std::back_inserter(vec));
     return up;
 }
 
+// 整型数组的批量序列化与反序列化，与逐个元素的格式相同 =>
+
+inline void marshal_array(DSPack & p, const uint8_t * pData, size_t nCount) { p.push(pData, nCount); }
+inline void marshal_array(DSPack & p, const uint16_t * pData, size_t nCount) { p.push_uint16_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const uint32_t * pData, size_t nCount) { p.push_uint32_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const uint64_t * pData, size_t nCount) { p.push_uint64_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const int8_t * pData, size_t nCount) { p.push(pData, nCount); }
+inline void marshal_array(DSPack & p, const int16_t * pData, size_t nCount) { p.push_int16_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const int32_t * pData, size_t nCount) { p.push_int32_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const int64_t * pData, size_t nCount) { p.push_int64_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const float * pData, size_t nCount) { p.push_float_array(pData, nCount); }
+inline void marshal_array(DSPack & p, const double * pData, size_t nCount) { p.push_double_array(pData, nCount); }
+
+inline void unmarshal_array(const DSUnpack & up, uint8_t * pData, size_t nCount) { up.pop_uint8_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, uint16_t * pData, size_t nCount) { up.pop_uint16_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, uint32_t * pData, size_t nCount) { up.pop_uint32_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, uint64_t * pData, size_t nCount) { up.pop_uint64_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, int8_t * pData, size_t nCount) { up.pop_uint8_array((uint8_t *)pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, int16_t * pData, size_t nCount) { up.pop_int16_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, int32_t * pData, size_t nCount) { up.pop_int32_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, int64_t * pData, size_t nCount) { up.pop_int64_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, float * pData, size_t nCount) { up.pop_float_array(pData, nCount); }
+inline void unmarshal_array(const DSUnpack & up, double * pData, size_t nCount) { up.pop_double_array(pData, nCount); }
+
+template <class T>
+inline void marshal_array_vector(DSPack & p, const std::vector<T> & vec)
+{
+    p.push_uint32(uint32_t(vec.size()));
+    if (!vec.empty())
+        marshal_array(p, &vec[0], vec.size());
+}
+
+template <class T>
+inline void unmarshal_array_vector(const DSUnpack & up, std::vector<T> & vec)
+{
+    // 紧凑模式下整数元素至少1字节
+    size_t count = up.pop_uint32();
+    if (up.pop_fetch_array(count, (up.compact() ? 1 : sizeof(T)), true) == NULL)
+        return;
+
+    size_t nOldSize = vec.size();
+    vec.resize(nOldSize + count);
+    if (count > 0)
+        unmarshal_array(up, &vec[nOldSize], count);
+}
+
+inline DSPack & operator << (DSPack & p, const std::vector<uint8_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<uint16_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<uint32_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<uint64_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<int8_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<int16_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<int32_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<int64_t> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<float> & vec) { marshal_array_vector(p, vec); return p; }
+inline DSPack & operator << (DSPack & p, const std::vector<double> & vec) { marshal_array_vector(p, vec); return p; }
+
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<uint8_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<uint16_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<uint32_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<uint64_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<int8_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<int16_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<int32_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<int64_t> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<float> & vec) { unmarshal_array_vector(up, vec); return up; }
+inline const DSUnpack & operator >> (const DSUnpack & up, std::vector<double> & vec) { unmarshal_array_vector(up, vec); return up; }
+
 template <class T>
 inline DSPack & operator << (DSPack & p, const std::set<T> & set)
 {
@@ -476,7 +1942,7 @@ inline DSPack & operator << (DSPack & p, const std::set<T> & set)
 template <class T>
 inline const DSUnpack & operator >> (const DSUnpack & up, std::set<T> & set)
 {
-    unmarshal_container(up, std::inserter(set, set.begin()));
+    unmarshal_ordered<T>(up, set);
     return up;
 }
 
@@ -490,10 +1956,188 @@ inline DSPack & operator << (DSPack & p, const std::map<T1, T2> & map)
 template <class T1, class T2>
 inline const DSUnpack & operator >> (const DSUnpack & up, std::map<T1, T2> & map)
 {
-    unmarshal_container(up, std::inserter(map, map.begin()));
+    unmarshal_ordered< std::pair<T1, T2> >(up, map);
+    return up;
+}
+
+template <class T>
+inline DSPack & operator << (DSPack & p, const std::deque<T> & deq)
+{
+    marshal_container(p, deq);
+    return p;
+}
+
+template <class T>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::deque<T> & deq)
+{
+    unmarshal_sequence(up, deq, up.pop_uint32());
+    return up;
+}
+
+template <class T>
+inline DSPack & operator << (DSPack & p, const std::list<T> & lst)
+{
+    marshal_container(p, lst);
+    return p;
+}
+
+template <class T>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::list<T> & lst)
+{
+    unmarshal_sequence(up, lst, up.pop_uint32());
+    return up;
+}
+
+#if __cplusplus >= 201103L
+
+// std::array与std::vector的格式相同，解包时元素个数必须等于N
+template <class T, size_t N>
+inline DSPack & operator << (DSPack & p, const std::array<T, N> & arr)
+{
+    marshal_container(p, arr);
+    return p;
+}
+
+template <class T, size_t N>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::array<T, N> & arr)
+{
+    if (up.pop_uint32() != N)
+    {
+        up.fail(DS_UNPACK_BAD_VALUE, "[DSUnpack::operator>>] std::array size mismatch");
+        return up;
+    }
+
+    for (size_t i = 0; i < N && up.ok(); ++i)
+        up >> arr[i];
+    return up;
+}
+
+// 无序容器按元素个数一次预留桶，避免插入过程中反复rehash
+template < typename ItemType, typename OutputContainer >
+inline void unmarshal_hashed(const DSUnpack & up, OutputContainer & c)
+{
+    size_t count = up.pop_uint32();
+    c.reserve(c.size() + unmarshal_reserve_count(up, count));
+
+    for (; count > 0 && up.ok(); --count)
+    {
+        ItemType tmp;
+        up >> tmp;
+        c.emplace(std::move(tmp));
+    }
+}
+
+template <class T, class H, class E>
+inline DSPack & operator << (DSPack & p, const std::unordered_set<T, H, E> & set)
+{
+    marshal_container(p, set);
+    return p;
+}
+
+template <class T, class H, class E>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::unordered_set<T, H, E> & set)
+{
+    unmarshal_hashed<T>(up, set);
+    return up;
+}
+
+template <class T1, class T2, class H, class E>
+inline DSPack & operator << (DSPack & p, const std::unordered_map<T1, T2, H, E> & map)
+{
+    marshal_container(p, map);
+    return p;
+}
+
+template <class T1, class T2, class H, class E>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::unordered_map<T1, T2, H, E> & map)
+{
+    unmarshal_hashed< std::pair<T1, T2> >(up, map);
+    return up;
+}
+
+#endif
+
+#if __cplusplus >= 201703L
+
+// std::optional为1字节是否有值(0或1)，有值时后跟值
+template <class T>
+inline DSPack & operator << (DSPack & p, const std::optional<T> & opt)
+{
+    p.push_uint8(opt.has_value() ? 1 : 0);
+    if (opt.has_value())
+        p << *opt;
+    return p;
+}
+
+template <class T>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::optional<T> & opt)
+{
+    uint8_t nFlag = up.pop_uint8();
+    if (!up.ok())
+        return up;
+
+    if (nFlag > 1)
+    {
+        up.fail(DS_UNPACK_BAD_VALUE, "[DSUnpack::operator>>] bad std::optional flag");
+        return up;
+    }
+
+    if (nFlag == 1)
+        up >> opt.emplace();
+    else
+        opt.reset();
+    return up;
+}
+
+// std::variant为1字节备选类型的序号，后跟该类型的值
+template <class... T>
+inline DSPack & operator << (DSPack & p, const std::variant<T...> & var)
+{
+    static_assert(sizeof...(T) < 0xFF, "too many variant alternatives");
+
+    if (var.valueless_by_exception())
+        throw DSError("[DSPack::operator<<] valueless std::variant");
+
+    p.push_uint8(uint8_t(var.index()));
+    std::visit([&p](const auto & t) { p << t; }, var);
+    return p;
+}
+
+template <size_t I, class Variant>
+inline void ds_unmarshal_alternative(const DSUnpack & up, Variant & var)
+{
+    up >> var.template emplace<I>();
+}
+
+// 按序号查表构造对应的备选类型，再直接解到其上
+template <class... T, size_t... I>
+inline void ds_unmarshal_variant(const DSUnpack & up, std::variant<T...> & var, size_t nIndex, std::index_sequence<I...>)
+{
+    typedef void (*UNMARSHAL_FUNC)(const DSUnpack &, std::variant<T...> &);
+    static const UNMARSHAL_FUNC s_arrFunc[] = { &ds_unmarshal_alternative< I, std::variant<T...> >... };
+
+    s_arrFunc[nIndex](up, var);
+}
+
+template <class... T>
+inline const DSUnpack & operator >> (const DSUnpack & up, std::variant<T...> & var)
+{
+    size_t nIndex = up.pop_uint8();
+    if (!up.ok())
+        return up;
+
+    if (nIndex >= sizeof...(T))
+    {
+        up.fail(DS_UNPACK_BAD_VALUE, "[DSUnpack::operator>>] bad std::variant index");
+        return up;
+    }
+
+    ds_unmarshal_variant(up, var, nIndex, std::index_sequence_for<T...>());
     return up;
 }
 
+#endif
+
 // 结构类型的序列化与反序列化 =>
 
 struct Marshallable
@@ -522,15 +2166,57 @@ inline const DSUnpack & operator >> (const DSUnpack & p, Marshallable & m)
     return p;
 }
 
+// 计算对象序列化后的长度
+template <typename T>
+inline size_t marshal_size(const T & t, bool bCompact = false)
+{
+    DSSizer sizer(bCompact);
+    sizer << t;
+    return sizer.size();
+}
+
+// 以下序列化入口先计算长度并一次分配到位，压包过程中不再扩容
+
 inline void Object2String(const Marshallable & obj, std::string & str)
 {
     DSPackBuffer buffer;
+    buffer.reserve(marshal_size(obj));
+
     DSPack pack(buffer);
 
     obj.marshal(pack);
     str.assign(pack.data(), pack.size());
+
+    DS_STATS_PACK(obj, pack.size());
+}
+
+// 将对象序列化到调用者的压包缓冲区，之后可通过swap()/release()移交
+inline void Object2Buffer(const Marshallable & obj, DSPackBuffer & buffer)
+{
+    buffer.reserve(buffer.size() + marshal_size(obj));
+
+    DSPack pack(buffer);
+
+    obj.marshal(pack);
+
+    DS_STATS_PACK(obj, pack.size());
+}
+
+// 将对象直接序列化到调用者的字符串中，省去从压包缓冲区的复制
+inline void Object2StringDirect(const Marshallable & obj, std::string & str)
+{
+    str.clear();
+    str.reserve(marshal_size(obj));
+
+    DSStringPackBuffer buffer(str);
+    DSPack pack(buffer);
+
+    obj.marshal(pack);
+
+    DS_STATS_PACK(obj, pack.size());
 }
 
+// 以抛异常模式解包，数据不足或格式错误时在第一次失败的解包处中止unmarshal()并返回false
 inline bool String2Object(const std::string & str, Marshallable & obj)
 {
     try
@@ -538,6 +2224,7 @@ inline bool String2Object(const std::string & str, Marshallable & obj)
         DSUnpack unpack(str.data(), str.size());
 
         obj.unmarshal(unpack);
+        DS_STATS_UNPACK(str.size());
     }
     catch (const DSError & e)
     {
@@ -547,6 +2234,246 @@ inline bool String2Object(const std::string & str, Marshallable & obj)
     return true;
 }
 
+// 以不抛异常模式解包，畸形数据只走分支判断而不触发异常展开，适合需要大量拒绝畸形数据的场合；
+// 失败后unmarshal()不会中止，之后的解包都返回0值，其中按解出的个数自行循环时须同时检查up.ok()；
+// 保留catch只为兼容用户在unmarshal()中自行抛出的DSError
+inline bool String2ObjectNoThrow(const std::string & str, Marshallable & obj)
+{
+    try
+    {
+        DSUnpack unpack(str.data(), str.size());
+        unpack.set_nothrow(true);
+
+        obj.unmarshal(unpack);
+        DS_STATS_UNPACK(str.size());
+
+        return unpack.ok();
+    }
+    catch (const DSError & e)
+    {
+        return false;
+    }
+}
+
+#if __cplusplus >= 201103L
+
+// 字段列表反射 =>
+// 在结构体内声明DS_FIELDS(类型名, 字段...)，生成非虚的marshal/unmarshal与长度计算函数，
+// 通过下面的<<与>>操作时不经过虚函数，嵌套的结构体可被编译器完全内联；
+// 若结构体继承自Marshallable，生成的marshal/unmarshal同时作为虚函数的实现。
+// 长度均按非紧凑模式计算
+
+// 检查类型是否自身声明了DS_FIELDS，派生类不继承基类的字段列表
+template <typename T, typename Enable = void>
+struct DSHasFields : std::false_type {};
+
+template <typename T>
+struct DSHasFields<T, typename std::enable_if<std::is_same<typename T::DSFieldsType, T>::value>::type> : std::true_type {};
+
+// 类型序列化后的长度：minSize()为最小长度，fixed()表示长度固定，size()计算实际长度
+template <typename T, typename Enable = void>
+struct DSWireSize
+{
+    static constexpr size_t minSize() { return 0; }
+    static constexpr bool fixed() { return false; }
+    static size_t size(const T & t) { return marshal_size(t); }
+};
+
+template <typename T>
+struct DSWireSize<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static constexpr size_t minSize() { return sizeof(T); }
+    static constexpr bool fixed() { return true; }
+    static size_t size(const T &) { return sizeof(T); }
+};
+
+template <>
+struct DSWireSize<std::string>
+{
+    static constexpr size_t minSize() { return 2; }
+    static constexpr bool fixed() { return false; }
+    static size_t size(const std::string & str) { return 2 + str.size(); }
+};
+
+template <>
+struct DSWireSize<StringPtr>
+{
+    static constexpr size_t minSize() { return 2; }
+    static constexpr bool fixed() { return false; }
+    static size_t size(const StringPtr & SP) { return 2 + SP.m_nSize; }
+};
+
+template <typename T1, typename T2>
+struct DSWireSize< std::pair<T1, T2> >
+{
+    typedef DSWireSize<typename std::remove_const<T1>::type> First_t;
+    typedef DSWireSize<T2> Second_t;
+
+    static constexpr size_t minSize() { return First_t::minSize() + Second_t::minSize(); }
+    static constexpr bool fixed() { return First_t::fixed() && Second_t::fixed(); }
+    static size_t size(const std::pair<T1, T2> & pair) { return First_t::size(pair.first) + Second_t::size(pair.second); }
+};
+
+// 容器为4字节元素个数加各元素长度，元素定长时直接相乘
+template <typename ContainerClass>
+struct DSWireSize_Container
+{
+    typedef DSWireSize<typename ContainerClass::value_type> Item_t;
+
+    static constexpr size_t minSize() { return 4; }
+    static constexpr bool fixed() { return false; }
+    static size_t size(const ContainerClass & c)
+    {
+        if (Item_t::fixed())
+            return 4 + c.size() * Item_t::minSize();
+
+        size_t nSize = 4;
+        for (typename ContainerClass::const_iterator i = c.begin(); i != c.end(); ++i)
+            nSize += Item_t::size(*i);
+        return nSize;
+    }
+};
+
+template <typename T>
+struct DSWireSize< std::vector<T> > : public DSWireSize_Container< std::vector<T> > {};
+
+template <typename T>
+struct DSWireSize< std::set<T> > : public DSWireSize_Container< std::set<T> > {};
+
+template <typename T1, typename T2>
+struct DSWireSize< std::map<T1, T2> > : public DSWireSize_Container< std::map<T1, T2> > {};
+
+template <typename T>
+struct DSWireSize< std::deque<T> > : public DSWireSize_Container< std::deque<T> > {};
+
+template <typename T>
+struct DSWireSize< std::list<T> > : public DSWireSize_Container< std::list<T> > {};
+
+template <typename T, typename H, typename E>
+struct DSWireSize< std::unordered_set<T, H, E> > : public DSWireSize_Container< std::unordered_set<T, H, E> > {};
+
+template <typename T1, typename T2, typename H, typename E>
+struct DSWireSize< std::unordered_map<T1, T2, H, E> > : public DSWireSize_Container< std::unordered_map<T1, T2, H, E> > {};
+
+// std::array元素个数固定，元素定长时整体定长
+template <typename T, size_t N>
+struct DSWireSize< std::array<T, N> >
+{
+    typedef DSWireSize<T> Item_t;
+
+    static constexpr size_t minSize() { return 4 + N * Item_t::minSize(); }
+    static constexpr bool fixed() { return Item_t::fixed(); }
+    static size_t size(const std::array<T, N> & arr)
+    {
+        if (Item_t::fixed())
+            return minSize();
+
+        size_t nSize = 4;
+        for (size_t i = 0; i < N; ++i)
+            nSize += Item_t::size(arr[i]);
+        return nSize;
+    }
+};
+
+#if __cplusplus >= 201703L
+template <typename T>
+struct DSWireSize< std::optional<T> >
+{
+    static constexpr size_t minSize() { return 1; }
+    static constexpr bool fixed() { return false; }
+    static size_t size(const std::optional<T> & opt) { return 1 + (opt.has_value() ? DSWireSize<T>::size(*opt) : 0); }
+};
+
+template <typename... T>
+struct DSWireSize< std::variant<T...> >
+{
+    static constexpr size_t minSize() { return 1; }
+    static constexpr bool fixed() { return false; }
+    static size_t size(const std::variant<T...> & var)
+    {
+        return 1 + std::visit([](const auto & t) { return DSWireSize<typename std::decay<decltype(t)>::type>::size(t); }, var);
+    }
+};
+#endif
+
+template <typename T>
+struct DSWireSize<T, typename std::enable_if<DSHasFields<T>::value>::type>
+{
+    static constexpr size_t minSize() { return T::ds_min_size(); }
+    static constexpr bool fixed() { return T::ds_fixed(); }
+    static size_t size(const T & t) { return t.ds_size(); }
+};
+
+// 字段列表的辅助函数，由DS_FIELDS展开调用 =>
+
+template <typename... T>
+struct DSFieldsSize;
+
+template <>
+struct DSFieldsSize<>
+{
+    static constexpr size_t minSize() { return 0; }
+    static constexpr bool fixed() { return true; }
+};
+
+template <typename T, typename... R>
+struct DSFieldsSize<T, R...>
+{
+    static constexpr size_t minSize() { return DSWireSize<T>::minSize() + DSFieldsSize<R...>::minSize(); }
+    static constexpr bool fixed() { return DSWireSize<T>::fixed() && DSFieldsSize<R...>::fixed(); }
+};
+
+// 仅用于decltype推导字段类型，不需要定义
+template <typename... T>
+DSFieldsSize<T...> ds_fields_size_of(const T &...);
+
+inline size_t ds_fields_wire_size() { return 0; }
+
+template <typename T, typename... R>
+inline size_t ds_fields_wire_size(const T & t, const R &... r)
+{
+    return DSWireSize<T>::size(t) + ds_fields_wire_size(r...);
+}
+
+template <typename... T>
+inline void ds_pack_fields(DSPack & p, const T &... t)
+{
+    int dummy[] = { 0, ((void)(p << t), 0)... };
+    (void)dummy;
+}
+
+template <typename... T>
+inline void ds_unpack_fields(const DSUnpack & up, T &... t)
+{
+    int dummy[] = { 0, ((void)(up >> t), 0)... };
+    (void)dummy;
+}
+
+// 声明了DS_FIELDS的类型直接调用生成的函数，比Marshallable的重载更匹配
+template <typename T>
+inline typename std::enable_if<DSHasFields<T>::value, DSPack &>::type operator << (DSPack & p, const T & t)
+{
+    t.T::marshal(p);
+    return p;
+}
+
+template <typename T>
+inline typename std::enable_if<DSHasFields<T>::value, const DSUnpack &>::type operator >> (const DSUnpack & up, T & t)
+{
+    t.T::unmarshal(up);
+    return up;
+}
+
+#define DS_FIELDS(Type, ...) \
+    typedef Type DSFieldsType; \
+    void marshal(dakuang::DSPack & p) const { dakuang::ds_pack_fields(p, __VA_ARGS__); } \
+    void unmarshal(const dakuang::DSUnpack & up) { dakuang::ds_unpack_fields(up, __VA_ARGS__); } \
+    size_t ds_size() const { return dakuang::ds_fields_wire_size(__VA_ARGS__); } \
+    static constexpr size_t ds_min_size() { return decltype(dakuang::ds_fields_size_of(__VA_ARGS__))::minSize(); } \
+    static constexpr bool ds_fixed() { return decltype(dakuang::ds_fields_size_of(__VA_ARGS__))::fixed(); }
+
+#endif
+
 }
 
 #endif //__DSPACKET_H__
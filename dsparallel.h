@@ -0,0 +1,253 @@
+﻿#ifndef __DSPARALLEL_H__
+#define __DSPARALLEL_H__
+
+#include "dsframe.h"
+
+#if __cplusplus >= 201103L
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace dakuang
+{
+
+// 多线程并行处理 =>
+// 任务被切成若干小块，各线程从共享的位置计数器上原子地领取下一块，先做完的线程自然多领，
+// 对互相独立的记录能达到与工作窃取相同的负载均衡，且不需要每线程的任务队列
+
+inline size_t DSHardwareThreads()
+{
+    size_t nThreads = std::thread::hardware_concurrency();
+    return (nThreads > 0 ? nThreads : 1);
+}
+
+// 并行处理[0, nCount)，由nThreads个线程(0为硬件线程数，调用线程也参与)按块领取，
+// 每块nGrain个(0为自动选择)，调用func(nBegin, nEnd, nThread)，nThread为线程序号[0, nThreads)；
+// 任何一块抛出的首个异常在所有线程结束后重新抛出
+template <typename Func>
+inline void DSParallelFor(size_t nCount, size_t nThreads, const Func & func, size_t nGrain = 0)
+{
+    if (nThreads == 0)
+        nThreads = DSHardwareThreads();
+
+    // 自动选择时每线程约16块，兼顾负载均衡与领取开销
+    if (nGrain == 0)
+    {
+        nGrain = nCount / (nThreads * 16);
+        if (nGrain < 16)
+            nGrain = 16;
+    }
+
+    size_t nChunks = (nCount + nGrain - 1) / nGrain;
+    if (nThreads > nChunks)
+        nThreads = nChunks;
+
+    if (nThreads <= 1)
+    {
+        if (nCount > 0)
+            func(size_t(0), nCount, size_t(0));
+        return;
+    }
+
+    std::atomic<size_t> nNext(0);
+    std::exception_ptr pError;
+    std::mutex mtxError;
+
+    auto worker = [&](size_t nThread)
+    {
+        try
+        {
+            for (;;)
+            {
+                size_t nBegin = nNext.fetch_add(nGrain);
+                if (nBegin >= nCount)
+                    break;
+
+                func(nBegin, (nCount - nBegin < nGrain ? nCount : nBegin + nGrain), nThread);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mtxError);
+            if (!pError)
+                pError = std::current_exception();
+            nNext = nCount;
+        }
+    };
+
+    std::vector<std::thread> vecThread;
+    vecThread.reserve(nThreads - 1);
+    for (size_t i = 1; i < nThreads; ++i)
+        vecThread.push_back(std::thread(worker, i));
+
+    worker(0);
+
+    for (size_t i = 0; i < vecThread.size(); ++i)
+        vecThread[i].join();
+
+    if (pError)
+        std::rethrow_exception(pError);
+}
+
+// 扫描长度前缀，将每条记录的内容追加到vecRecord，返回完整记录占用的长度，末尾不完整的记录不计入；
+// 记录格式与DSFrameDecoder、DSRecordReader相同
+inline size_t DSIndexRecords(const char * pData, size_t nSize, std::vector<StringPtr> & vecRecord)
+{
+    size_t nPos = 0;
+    while (nSize - nPos >= size_t(DSFrameDecoder::headerSize))
+    {
+        uint32_t u32;
+        memcpy(&u32, pData + nPos, DSFrameDecoder::headerSize);
+        u32 = DSWireOrder::conv32(u32);
+
+        if (u32 > nSize - nPos - DSFrameDecoder::headerSize)
+            break;
+
+        vecRecord.push_back(StringPtr(pData + nPos + DSFrameDecoder::headerSize, u32));
+        nPos += DSFrameDecoder::headerSize + u32;
+    }
+    return nPos;
+}
+
+// 并行解码索引中的记录并追加到vecOut，以不抛异常模式解包，有记录解码失败时返回false；
+// bOrdered为true时结果与记录顺序一致(失败的记录重置为默认值)，
+// 否则各线程先解到自己的输出中再合并，只保留解码成功的记录，顺序不定
+template <typename T>
+inline bool DSParallelDecode(const std::vector<StringPtr> & vecRecord, std::vector<T> & vecOut, size_t nThreads = 0, bool bOrdered = true)
+{
+    if (nThreads == 0)
+        nThreads = DSHardwareThreads();
+
+    std::atomic<size_t> nFailed(0);
+
+    if (bOrdered)
+    {
+        size_t nOldSize = vecOut.size();
+        vecOut.resize(nOldSize + vecRecord.size());
+
+        DSParallelFor(vecRecord.size(), nThreads, [&](size_t nBegin, size_t nEnd, size_t)
+        {
+            size_t nFail = 0;
+            for (size_t i = nBegin; i < nEnd; ++i)
+            {
+                DSUnpack up(vecRecord[i].m_pData, vecRecord[i].m_nSize);
+                up.set_nothrow(true);
+                up >> vecOut[nOldSize + i];
+                if (!up.ok())
+                {
+                    // 原地解码失败时可能已写入部分字段，重置为默认值
+                    vecOut[nOldSize + i] = T();
+                    ++nFail;
+                }
+                DS_STATS_UNPACK(vecRecord[i].m_nSize);
+            }
+            nFailed += nFail;
+        });
+    }
+    else
+    {
+        std::vector< std::vector<T> > vecLocal(nThreads);
+
+        DSParallelFor(vecRecord.size(), nThreads, [&](size_t nBegin, size_t nEnd, size_t nThread)
+        {
+            std::vector<T> & vecThreadOut = vecLocal[nThread];
+            size_t nFail = 0;
+            for (size_t i = nBegin; i < nEnd; ++i)
+            {
+                DSUnpack up(vecRecord[i].m_pData, vecRecord[i].m_nSize);
+                up.set_nothrow(true);
+
+                vecThreadOut.push_back(T());
+                up >> vecThreadOut.back();
+                if (!up.ok())
+                {
+                    vecThreadOut.pop_back();
+                    ++nFail;
+                }
+                DS_STATS_UNPACK(vecRecord[i].m_nSize);
+            }
+            nFailed += nFail;
+        });
+
+        size_t nTotal = vecOut.size();
+        for (size_t i = 0; i < vecLocal.size(); ++i)
+            nTotal += vecLocal[i].size();
+        vecOut.reserve(nTotal);
+
+        for (size_t i = 0; i < vecLocal.size(); ++i)
+        {
+            for (size_t j = 0; j < vecLocal[i].size(); ++j)
+                vecOut.push_back(std::move(vecLocal[i][j]));
+        }
+    }
+
+    return (nFailed == 0);
+}
+
+// 并行解码一段连续内存(如DSRecordReader映射的文件)中的全部记录，末尾有不完整的记录时也返回false
+template <typename T>
+inline bool DSParallelDecode(const char * pData, size_t nSize, std::vector<T> & vecOut, size_t nThreads = 0, bool bOrdered = true)
+{
+    std::vector<StringPtr> vecRecord;
+    size_t nUsed = DSIndexRecords(pData, nSize, vecRecord);
+
+    bool bRet = DSParallelDecode(vecRecord, vecOut, nThreads, bOrdered);
+    return (bRet && nUsed == nSize);
+}
+
+// 并行序列化容器，输出与marshal_container()逐字节相同：
+// 把元素切成若干段，各线程把各段压入自己的压包缓冲区(紧凑模式与p相同)，再按段的顺序一次性拼接到p；
+// 要求容器支持随机访问，元素数少于nMinCount时直接逐个序列化；
+// Object2String等先用DSSizer计算长度，此时p只累加长度，同样逐个累加而不启动线程压包
+template <typename ContainerClass>
+inline void marshal_container_parallel(DSPack & p, const ContainerClass & c, size_t nThreads = 0, size_t nMinCount = 4096)
+{
+    if (nThreads == 0)
+        nThreads = DSHardwareThreads();
+
+    if (nThreads <= 1 || c.size() < nMinCount || p.size_only())
+        return marshal_container(p, c);
+
+    // 段数为线程数的4倍，先做完的线程可以多领
+    size_t nCount = c.size();
+    size_t nShards = nThreads * 4;
+    size_t nShardSize = (nCount + nShards - 1) / nShards;
+    nShards = (nCount + nShardSize - 1) / nShardSize;
+
+    std::vector<DSPackBuffer> vecBuffer(nShards);
+    DSParallelFor(nShards, nThreads, [&](size_t nBegin, size_t nEnd, size_t)
+    {
+        for (size_t i = nBegin; i < nEnd; ++i)
+        {
+            DSPack pack(vecBuffer[i]);
+            pack.set_compact(p.compact());
+
+            size_t nItemEnd = ((i + 1) * nShardSize < nCount ? (i + 1) * nShardSize : nCount);
+            for (typename ContainerClass::const_iterator it = c.begin() + i * nShardSize; it != c.begin() + nItemEnd; ++it)
+                pack << *it;
+        }
+    }, 1);
+
+    size_t nTotal = 0;
+    for (size_t i = 0; i < nShards; ++i)
+        nTotal += vecBuffer[i].size();
+
+    p.push_uint32(uint32_t(nCount));
+
+    char * pDst = p.reserve_block(nTotal);
+    for (size_t i = 0; i < nShards; ++i)
+    {
+        if (vecBuffer[i].size() > 0)
+            memcpy(pDst, vecBuffer[i].data(), vecBuffer[i].size());
+        pDst += vecBuffer[i].size();
+    }
+    p.commit_block(nTotal);
+}
+
+}
+
+#endif
+
+#endif // __DSPARALLEL_H__
@@ -0,0 +1,240 @@
+﻿#ifndef __DSRECORD_H__
+#define __DSRECORD_H__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "dsframe.h"
+
+namespace dakuang
+{
+
+// 记录文件格式与DSFrameDecoder的帧相同，每条记录为4字节长度加记录内容 =>
+
+// 定义记录文件写入器，记录先压入缓冲区，累计到一定长度后一次写入文件
+class DSRecordWriter
+{
+private:
+    int m_fd;
+    size_t m_nFlushSize;
+    DSPackBuffer m_buffer;
+
+    DSRecordWriter(const DSRecordWriter &);
+    DSRecordWriter & operator = (const DSRecordWriter &);
+
+public:
+    explicit DSRecordWriter(size_t nFlushSize = 4 * 1024 * 1024)
+        : m_fd(-1)
+        , m_nFlushSize(nFlushSize)
+    {
+    }
+    ~DSRecordWriter() { close(); }
+
+    // 打开记录文件，bAppend为false时清空原有内容
+    bool open(const char * pPath, bool bAppend = true)
+    {
+        close();
+
+        m_fd = ::open(pPath, O_WRONLY | O_CREAT | (bAppend ? O_APPEND : O_TRUNC), 0644);
+        return (m_fd >= 0);
+    }
+
+    // 写出缓冲的记录后关闭文件
+    bool close()
+    {
+        if (m_fd < 0)
+            return true;
+
+        bool bRet = flush();
+        ::close(m_fd);
+        m_fd = -1;
+        return bRet;
+    }
+
+    bool is_open() const { return m_fd >= 0; }
+
+    // 追加一条记录，缓冲区超过写出长度时写入文件
+    // 压包失败时撤销已写入的部分，缓冲区溢出返回false，对象marshal()抛出的其它异常继续抛出
+    template <typename T>
+    bool append(const T & obj)
+    {
+        size_t nPos = m_buffer.size();
+        try
+        {
+            Object2Frame(obj, m_buffer);
+        }
+        catch (const DSError &)
+        {
+            m_buffer.resize(nPos);
+            return false;
+        }
+        catch (...)
+        {
+            m_buffer.resize(nPos);
+            throw;
+        }
+
+        return (m_buffer.size() < m_nFlushSize || flush());
+    }
+
+    // 追加一条已序列化的记录，长度超出4字节的帧头或缓冲区溢出时返回false
+    bool append(const void * pData, size_t nSize)
+    {
+        if (nSize > 0xFFFFFFFF)
+            return false;
+
+        size_t nPos = m_buffer.size();
+        try
+        {
+            uint32_t u32 = DSWireOrder::conv32(uint32_t(nSize));
+            m_buffer.append((const char *)&u32, DSFrameDecoder::headerSize);
+            m_buffer.append((const char *)pData, nSize);
+        }
+        catch (const DSError &)
+        {
+            m_buffer.resize(nPos);
+            return false;
+        }
+
+        return (m_buffer.size() < m_nFlushSize || flush());
+    }
+
+    // 将缓冲的记录写入文件，失败时已写入的部分从缓冲区移除，重试时不会重复写入
+    bool flush()
+    {
+        const char * pData = m_buffer.data();
+        size_t nLeft = m_buffer.size();
+        size_t nWritten = 0;
+        while (nLeft > 0)
+        {
+            ssize_t n = ::write(m_fd, pData + nWritten, nLeft);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                m_buffer.consume(nWritten);
+                return false;
+            }
+
+            nWritten += n;
+            nLeft -= n;
+        }
+
+        m_buffer.resize(0);
+        return true;
+    }
+};
+
+// 定义记录文件读取器，以只读方式映射整个文件，逐条返回指向映射区的DSUnpack视图，
+// 读取过程中没有内存分配与read()调用，解出的StringPtr在close()之前有效
+class DSRecordReader
+{
+private:
+    int m_fd;
+    const char * m_pData;
+    size_t m_nSize;
+    size_t m_nPos;
+
+    DSRecordReader(const DSRecordReader &);
+    DSRecordReader & operator = (const DSRecordReader &);
+
+public:
+    DSRecordReader()
+        : m_fd(-1)
+        , m_pData(NULL)
+        , m_nSize(0)
+        , m_nPos(0)
+    {
+    }
+    ~DSRecordReader() { close(); }
+
+    bool open(const char * pPath)
+    {
+        close();
+
+        m_fd = ::open(pPath, O_RDONLY);
+        if (m_fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(m_fd, &st) != 0)
+            return (close(), false);
+
+        m_nSize = size_t(st.st_size);
+        if (m_nSize == 0)
+            return true;
+
+        void * pData = mmap(NULL, m_nSize, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (pData == MAP_FAILED)
+            return (close(), false);
+
+#if defined(MADV_SEQUENTIAL)
+        madvise(pData, m_nSize, MADV_SEQUENTIAL);
+#endif
+        m_pData = (const char *)pData;
+        return true;
+    }
+
+    void close()
+    {
+        if (m_pData != NULL)
+            munmap((void *)m_pData, m_nSize);
+        if (m_fd >= 0)
+            ::close(m_fd);
+
+        m_fd = -1;
+        m_pData = NULL;
+        m_nSize = 0;
+        m_nPos = 0;
+    }
+
+    bool is_open() const { return m_fd >= 0; }
+
+    // 映射的文件内容与当前读取位置
+    const char * data() const { return m_pData; }
+    size_t size() const { return m_nSize; }
+    size_t offset() const { return m_nPos; }
+
+    // 从指定位置开始读取，位置必须是某条记录的起点
+    void seek(size_t nPos) { m_nPos = (nPos < m_nSize ? nPos : m_nSize); }
+    void rewind() { m_nPos = 0; }
+
+    // 文件末尾有写了一半的记录(如写入时进程异常退出)
+    bool truncated() const { return m_nPos < m_nSize && __recordSize() == 0; }
+
+    // 取出下一条记录，读完或遇到不完整的记录时返回false
+    bool next(const DSUnpack & up)
+    {
+        size_t nRecordSize = __recordSize();
+        if (nRecordSize == 0)
+            return false;
+
+        up.reset(m_pData + m_nPos + DSFrameDecoder::headerSize, nRecordSize - DSFrameDecoder::headerSize);
+        m_nPos += nRecordSize;
+        DS_STATS_UNPACK(nRecordSize - DSFrameDecoder::headerSize);
+        return true;
+    }
+
+private:
+    // 当前记录连同长度的总长，记录不完整时返回0
+    size_t __recordSize() const
+    {
+        size_t nLeft = m_nSize - m_nPos;
+        if (nLeft < size_t(DSFrameDecoder::headerSize))
+            return 0;
+
+        uint32_t u32;
+        memcpy(&u32, m_pData + m_nPos, DSFrameDecoder::headerSize);
+        u32 = DSWireOrder::conv32(u32);
+
+        return (u32 <= nLeft - DSFrameDecoder::headerSize ? DSFrameDecoder::headerSize + u32 : 0);
+    }
+};
+
+}
+
+#endif // __DSRECORD_H__
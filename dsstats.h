@@ -0,0 +1,274 @@
+﻿#ifndef __DSSTATS_H__
+#define __DSSTATS_H__
+
+// 运行统计 =>
+// 定义DS_ENABLE_STATS后启用：缓冲区扩容、块分配与释放、压包解包字节数，以及按类型的消息长度分布。
+// 计数器按线程存放，只做普通加法，不加锁也不用原子操作，其它线程不能读取；
+// 运行中的线程需自行读取DSStatsLocal()后用DSStatsMerge()汇总。C++11下线程退出时其统计并入全局的已退出汇总，
+// 可用DSStatsMergeExited()取得，DSParallelDecode()等内部线程池的统计由此取得；
+// C++11以前没有线程退出的回调，内部线程池的统计不可见。
+// 未定义时下面的统计宏为空，参数也不会求值
+
+#include <string.h>
+
+#include "dstypes.h"
+
+#if defined(DS_ENABLE_STATS)
+
+#include <typeinfo>
+#if __cplusplus >= 201103L
+#include <mutex>
+#endif
+
+#if __cplusplus >= 201103L
+#define DS_THREAD_LOCAL thread_local
+#elif defined(__GNUC__)
+#define DS_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define DS_THREAD_LOCAL __declspec(thread)
+#else
+#error "DS_ENABLE_STATS requires thread local storage"
+#endif
+
+// 每个线程最多分别统计的消息类型数，须为2的幂
+#ifndef DS_STATS_MAX_TYPES
+#define DS_STATS_MAX_TYPES 32
+#endif
+
+namespace dakuang
+{
+
+// 长度分布按2的幂分档：第0档为长度0，第i档为[2^(i-1), 2^i)，最后一档包含更大的长度
+enum { DS_STATS_HIST_BUCKETS = 33 };
+
+inline size_t DSStatsBucket(uint64_t nSize)
+{
+    if (nSize == 0)
+        return 0;
+
+#if defined(__GNUC__)
+    size_t nBucket = 64 - __builtin_clzll(nSize);
+#else
+    size_t nBucket = 0;
+    for (; nSize != 0; nSize >>= 1)
+        ++nBucket;
+#endif
+
+    return (nBucket < DS_STATS_HIST_BUCKETS ? nBucket : DS_STATS_HIST_BUCKETS - 1);
+}
+
+// 某一消息类型的统计，pType为NULL表示空位
+struct SDSTypeStats
+{
+    const std::type_info * pType;
+    uint64_t nCount;
+    uint64_t nBytes;
+    uint64_t arrHist[DS_STATS_HIST_BUCKETS];
+};
+
+struct SDSStats
+{
+    // DSBuffer
+    uint64_t nGrowCount;        // 扩容次数，只靠搬移到头部就满足的不计
+    uint64_t nGrowCopyBytes;    // 扩容时从旧内存复制到新内存的字节数
+    uint64_t nReallocCount;     // 分配器支持ordered_realloc时原地扩容的次数
+    uint64_t nCompactBytes;     // 把剩余数据搬移到头部的字节数
+    uint64_t nPeakCapacity;     // 单个缓冲区达到过的最大容量
+
+    // 分配器
+    uint64_t nMallocCount;      // ordered_malloc调用次数
+    uint64_t nMallocBytes;      // ordered_malloc分配的字节数
+    uint64_t nFreeCount;        // ordered_free调用次数
+
+    // 序列化入口
+    uint64_t nPackCount;
+    uint64_t nPackBytes;
+    uint64_t nUnpackCount;
+    uint64_t nUnpackBytes;
+
+    // 按类型的压包长度分布，类型数超出DS_STATS_MAX_TYPES后只计入nTypeOverflow
+    uint64_t nTypeOverflow;
+    SDSTypeStats arrType[DS_STATS_MAX_TYPES];
+};
+
+inline void DSStatsMerge(SDSStats & total, const SDSStats & stats);
+
+#if __cplusplus >= 201103L
+
+// 已退出线程的统计汇总
+struct SDSStatsExited
+{
+    std::mutex mutex;
+    SDSStats stats;
+};
+
+inline SDSStatsExited & DSStatsExited()
+{
+    static SDSStatsExited s_exited;
+    return s_exited;
+}
+
+// 线程退出时把本线程的统计并入已退出汇总
+struct SDSStatsHolder
+{
+    SDSStats stats;
+
+    SDSStatsHolder() { memset(&stats, 0, sizeof(stats)); }
+    ~SDSStatsHolder()
+    {
+        SDSStatsExited & exited = DSStatsExited();
+        std::lock_guard<std::mutex> lock(exited.mutex);
+        DSStatsMerge(exited.stats, stats);
+    }
+};
+
+// 当前线程的统计
+inline SDSStats & DSStatsLocal()
+{
+    static thread_local SDSStatsHolder s_holder;
+    return s_holder.stats;
+}
+
+// 把已退出线程的统计累加到汇总中
+inline void DSStatsMergeExited(SDSStats & total)
+{
+    SDSStatsExited & exited = DSStatsExited();
+    std::lock_guard<std::mutex> lock(exited.mutex);
+    DSStatsMerge(total, exited.stats);
+}
+
+inline void DSStatsResetExited()
+{
+    SDSStatsExited & exited = DSStatsExited();
+    std::lock_guard<std::mutex> lock(exited.mutex);
+    memset(&exited.stats, 0, sizeof(exited.stats));
+}
+
+#else
+
+// 当前线程的统计
+inline SDSStats & DSStatsLocal()
+{
+    static DS_THREAD_LOCAL SDSStats s_stats;
+    return s_stats;
+}
+
+#endif
+
+inline void DSStatsReset()
+{
+    memset(&DSStatsLocal(), 0, sizeof(SDSStats));
+}
+
+// 取当前线程中某类型的统计项，表满时返回NULL
+inline SDSTypeStats * DSStatsType(const std::type_info & type)
+{
+    SDSStats & stats = DSStatsLocal();
+
+    size_t nIndex = (size_t(&type) >> 4) & (DS_STATS_MAX_TYPES - 1);
+    for (size_t i = 0; i < DS_STATS_MAX_TYPES; ++i, nIndex = (nIndex + 1) & (DS_STATS_MAX_TYPES - 1))
+    {
+        SDSTypeStats & ts = stats.arrType[nIndex];
+        if (ts.pType == NULL)
+        {
+            ts.pType = &type;
+            return &ts;
+        }
+        if (ts.pType == &type || *ts.pType == type)
+            return &ts;
+    }
+
+    return NULL;
+}
+
+// 记录一条压包完成的消息
+inline void DSStatsPack(const std::type_info & type, size_t nSize)
+{
+    SDSStats & stats = DSStatsLocal();
+    stats.nPackCount++;
+    stats.nPackBytes += nSize;
+
+    SDSTypeStats * pTypeStats = DSStatsType(type);
+    if (pTypeStats == NULL)
+    {
+        stats.nTypeOverflow++;
+        return;
+    }
+
+    pTypeStats->nCount++;
+    pTypeStats->nBytes += nSize;
+    pTypeStats->arrHist[DSStatsBucket(nSize)]++;
+}
+
+// 把一个线程的统计累加到汇总中
+inline void DSStatsMerge(SDSStats & total, const SDSStats & stats)
+{
+    total.nGrowCount += stats.nGrowCount;
+    total.nGrowCopyBytes += stats.nGrowCopyBytes;
+    total.nReallocCount += stats.nReallocCount;
+    total.nCompactBytes += stats.nCompactBytes;
+    if (total.nPeakCapacity < stats.nPeakCapacity)
+        total.nPeakCapacity = stats.nPeakCapacity;
+
+    total.nMallocCount += stats.nMallocCount;
+    total.nMallocBytes += stats.nMallocBytes;
+    total.nFreeCount += stats.nFreeCount;
+
+    total.nPackCount += stats.nPackCount;
+    total.nPackBytes += stats.nPackBytes;
+    total.nUnpackCount += stats.nUnpackCount;
+    total.nUnpackBytes += stats.nUnpackBytes;
+
+    total.nTypeOverflow += stats.nTypeOverflow;
+    for (size_t i = 0; i < DS_STATS_MAX_TYPES; ++i)
+    {
+        const SDSTypeStats & ts = stats.arrType[i];
+        if (ts.pType == NULL)
+            continue;
+
+        // 汇总表按类型重新定位，不依赖与当前线程的表
+        SDSTypeStats * pDst = NULL;
+        for (size_t j = 0; j < DS_STATS_MAX_TYPES; ++j)
+        {
+            SDSTypeStats & dst = total.arrType[j];
+            if (dst.pType == NULL)
+                dst.pType = ts.pType;
+            if (dst.pType == ts.pType || *dst.pType == *ts.pType)
+            {
+                pDst = &dst;
+                break;
+            }
+        }
+
+        if (pDst == NULL)
+        {
+            total.nTypeOverflow += ts.nCount;
+            continue;
+        }
+
+        pDst->nCount += ts.nCount;
+        pDst->nBytes += ts.nBytes;
+        for (size_t k = 0; k < DS_STATS_HIST_BUCKETS; ++k)
+            pDst->arrHist[k] += ts.arrHist[k];
+    }
+}
+
+}
+
+#define DS_STATS_ADD(field, n) (::dakuang::DSStatsLocal().field += (n))
+#define DS_STATS_MAX(field, n) \
+    do { uint64_t dsStatsN_ = (n); if (::dakuang::DSStatsLocal().field < dsStatsN_) ::dakuang::DSStatsLocal().field = dsStatsN_; } while (0)
+#define DS_STATS_PACK(obj, n) ::dakuang::DSStatsPack(typeid(obj), (n))
+#define DS_STATS_UNPACK(n) \
+    do { ::dakuang::SDSStats & dsStats_ = ::dakuang::DSStatsLocal(); dsStats_.nUnpackCount++; dsStats_.nUnpackBytes += (n); } while (0)
+
+#else
+
+#define DS_STATS_ADD(field, n) ((void)0)
+#define DS_STATS_MAX(field, n) ((void)0)
+#define DS_STATS_PACK(obj, n) ((void)0)
+#define DS_STATS_UNPACK(n) ((void)0)
+
+#endif
+
+#endif // __DSSTATS_H__
@@ -17,6 +17,8 @@ typedef unsigned char bool;
 
 #elif defined(_MSC_VER)
 
+#include <stdlib.h>
+
 typedef signed char int8_t;
 typedef signed short int16_t;
 typedef signed int int32_t;
@@ -28,9 +30,61 @@ typedef unsigned __int64 uint64_t;
 
 #endif
 
+// 分散/聚集IO描述，用于writev/sendmsg
+#ifdef _MSC_VER
+
+struct iovec
+{
+	void * iov_base;
+	size_t iov_len;
+};
+
+#else
+
+#include <sys/uio.h>
+
+#endif
+
+// 本机字节序检测，GCC/Clang通过__BYTE_ORDER__判断，其它编译器按小端处理
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define DS_HOST_BIG_ENDIAN
+#endif
+
 namespace dakuang
 {
 
+	// 单个整数的字节交换，dspacket.h与simplemarshal.h共用
+	inline uint16_t DS_BSWAP16(uint16_t u16)
+	{
+#if defined(__GNUC__)
+		return __builtin_bswap16(u16);
+#elif defined(_MSC_VER)
+		return _byteswap_ushort(u16);
+#else
+		return ( (u16 << 8) | (u16 >> 8) );
+#endif
+	}
+	inline uint32_t DS_BSWAP32(uint32_t u32)
+	{
+#if defined(__GNUC__)
+		return __builtin_bswap32(u32);
+#elif defined(_MSC_VER)
+		return _byteswap_ulong(u32);
+#else
+		return ( (uint32_t(DS_BSWAP16(uint16_t(u32))) << 16) | DS_BSWAP16(uint16_t(u32 >> 16)) );
+#endif
+	}
+	inline uint64_t DS_BSWAP64(uint64_t u64)
+	{
+#if defined(__GNUC__)
+		return __builtin_bswap64(u64);
+#elif defined(_MSC_VER)
+		return _byteswap_uint64(u64);
+#else
+		return ( (uint64_t(DS_BSWAP32(uint32_t(u64))) << 32) | DS_BSWAP32(uint32_t(u64 >> 32)) );
+#endif
+	}
+
 	struct StringPtr
 	{
 		const char * m_pData;
@@ -4,15 +4,76 @@
 // 结构体转json序列化实现 =》
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <locale.h>
 #include <json/json.h>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
+#include <exception>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// C++17的std::to_chars/from_chars提供最短可还原的浮点数格式化与不依赖locale的解析，
+// 不支持时退化为snprintf/strtod，并在json的'.'与当前locale的小数点之间转换
+#if __cplusplus >= 201703L
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define JSON_HAVE_TO_CHARS
+#endif
+#endif
 
 namespace dakuang
 {
 
+// 浮点数转换的辅助函数 =>
+
+// 将double转为float，超出float范围的转换是未定义行为，返回false；
+// 略大于FLT_MAX但按舍入规则仍为FLT_MAX的值(如FLT_MAX输出的"3.4028235e+38")按FLT_MAX处理
+inline bool JsonDoubleToFloat(double d, float & f)
+{
+    // 2^128 - 2^103，即FLT_MAX加半个最小精度单位，不小于该值时舍入为inf
+    static const double dRoundMax = 3.4028235677973366e+38;
+
+    double dAbs = (d < 0 ? -d : d);
+    if (dAbs <= FLT_MAX)
+        f = float(d);
+    else if (dAbs < dRoundMax)
+        f = (d < 0 ? -FLT_MAX : FLT_MAX);
+    else
+        return false;
+
+    return true;
+}
+
+#if !defined(JSON_HAVE_TO_CHARS)
+// snprintf/strtod使用当前locale的小数点，只处理单字节的小数点
+inline char JsonDecimalPoint()
+{
+    const char * p = localeconv()->decimal_point;
+    return ((p != NULL && p[0] != '\0' && p[1] == '\0') ? p[0] : '.');
+}
+
+inline void JsonReplaceChar(char * p, size_t nSize, char cFrom, char cTo)
+{
+    if (cFrom == cTo)
+        return;
+
+    for (size_t i = 0; i < nSize; ++i)
+    {
+        if (p[i] == cFrom)
+            p[i] = cTo;
+    }
+}
+#endif
+
 // 基础数据类型的序列化与反序列化 =>
 
 inline Json::Value & operator << (Json::Value & js, bool b)
@@ -57,6 +118,30 @@ inline Json::Value & operator << (Json::Value & js, int32_t i32)
     return js;
 }
 
+inline Json::Value & operator << (Json::Value & js, uint64_t u64)
+{
+    js = (Json::UInt64)u64;
+    return js;
+}
+
+inline Json::Value & operator << (Json::Value & js, int64_t i64)
+{
+    js = (Json::Int64)i64;
+    return js;
+}
+
+inline Json::Value & operator << (Json::Value & js, float f)
+{
+    js = (double)f;
+    return js;
+}
+
+inline Json::Value & operator << (Json::Value & js, double d)
+{
+    js = d;
+    return js;
+}
+
 inline Json::Value & operator << (Json::Value & js, const std::string & str)
 {
     js = str;
@@ -105,6 +190,31 @@ inline const Json::Value & operator >> (const Json::Value & js, int32_t & i32)
     return js;
 }
 
+inline const Json::Value & operator >> (const Json::Value & js, uint64_t & u64)
+{
+    u64 = (uint64_t)js.asUInt64();
+    return js;
+}
+
+inline const Json::Value & operator >> (const Json::Value & js, int64_t & i64)
+{
+    i64 = (int64_t)js.asInt64();
+    return js;
+}
+
+inline const Json::Value & operator >> (const Json::Value & js, float & f)
+{
+    if (!JsonDoubleToFloat(js.asDouble(), f))
+        throw std::range_error("[operator>>] float out of range");
+    return js;
+}
+
+inline const Json::Value & operator >> (const Json::Value & js, double & d)
+{
+    d = js.asDouble();
+    return js;
+}
+
 inline const Json::Value & operator >> (const Json::Value & js, std::string & str)
 {
     str = js.asString();
@@ -128,7 +238,7 @@ inline Json::Value & operator << (Json::Value & js, const std::vector<T> & vec)
 template <typename T>
 inline const Json::Value & operator >> (const Json::Value & js, std::vector<T> & vec)
 {
-    for (size_t i = 0; i < js.size(); ++i)
+    for (Json::ArrayIndex i = 0; i < js.size(); ++i)
     {
         T t;
         js[i] >> t;
@@ -152,11 +262,11 @@ inline Json::Value & operator << (Json::Value & js, const std::set<T> & set)
 template <typename T>
 inline const Json::Value & operator >> (const Json::Value & js, std::set<T> & set)
 {
-    for (size_t i = 0; i < js.size(); ++i)
+    for (Json::ArrayIndex i = 0; i < js.size(); ++i)
     {
         T t;
         js[i] >> t;
-        set.push_back(t);
+        set.insert(t);
     }
     return js;
 }
@@ -185,6 +295,1152 @@ inline const Json::Value & operator >> (const Json::Value & js, std::map<std::st
     return js;
 }
 
+// 流式json输出 =>
+// 直接把紧凑格式的json追加到字符串，不构造Json::Value；对象内用 w["key"] << value 输出字段，逗号自动补充
+
+class JsonWriter
+{
+private:
+    std::string & m_str;
+    bool m_bComma;
+
+    JsonWriter(const JsonWriter &);
+    JsonWriter & operator = (const JsonWriter &);
+
+public:
+    explicit JsonWriter(std::string & str) : m_str(str), m_bComma(false) {}
+
+    std::string & str() { return m_str; }
+
+    void begin_object() { __separate(); m_str += '{'; m_bComma = false; }
+    void end_object() { m_str += '}'; m_bComma = true; }
+    void begin_array() { __separate(); m_str += '['; m_bComma = false; }
+    void end_array() { m_str += ']'; m_bComma = true; }
+
+    // 输出字段名，之后必须紧跟一个值
+    JsonWriter & key(const char * pKey, size_t nSize)
+    {
+        __separate();
+        __string(pKey, nSize);
+        m_str += ':';
+        m_bComma = false;
+        return *this;
+    }
+    JsonWriter & operator [] (const char * pKey) { return key(pKey, strlen(pKey)); }
+    JsonWriter & operator [] (const std::string & strKey) { return key(strKey.data(), strKey.size()); }
+
+    void write_null() { __separate(); m_str.append("null", 4); m_bComma = true; }
+    void write_bool(bool b) { __separate(); if (b) m_str.append("true", 4); else m_str.append("false", 5); m_bComma = true; }
+    inline void write_int(int64_t i64);
+    inline void write_uint(uint64_t u64);
+    inline void write_double(double d);
+    inline void write_float(float f);
+    void write_string(const char * pData, size_t nSize) { __separate(); __string(pData, nSize); m_bComma = true; }
+
+    // 输出Json::Value树，用于尚未实现流式输出的对象
+    inline void write_value(const Json::Value & js);
+    inline void write_members(const Json::Value & js);
+
+private:
+    void __separate()
+    {
+        if (m_bComma)
+            m_str += ',';
+    }
+
+    inline static char * __formatUInt(char * pEnd, uint64_t u64);
+    inline void __string(const char * pData, size_t nSize);
+    inline void __escape(unsigned char c);
+};
+
+// 从pEnd向前每次写入两位数字，返回起始位置
+inline char * JsonWriter::__formatUInt(char * pEnd, uint64_t u64)
+{
+    static const char s_szDigits[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    while (u64 >= 100)
+    {
+        unsigned int n = unsigned(u64 % 100);
+        u64 /= 100;
+        pEnd -= 2;
+        memcpy(pEnd, s_szDigits + n * 2, 2);
+    }
+
+    if (u64 >= 10)
+    {
+        pEnd -= 2;
+        memcpy(pEnd, s_szDigits + u64 * 2, 2);
+    }
+    else
+    {
+        *--pEnd = char('0' + u64);
+    }
+
+    return pEnd;
+}
+
+inline void JsonWriter::write_int(int64_t i64)
+{
+    __separate();
+
+    char szBuf[24];
+    char * pEnd = szBuf + sizeof(szBuf);
+    char * pBegin = __formatUInt(pEnd, i64 < 0 ? 0 - uint64_t(i64) : uint64_t(i64));
+    if (i64 < 0)
+        *--pBegin = '-';
+
+    m_str.append(pBegin, pEnd - pBegin);
+    m_bComma = true;
+}
+
+inline void JsonWriter::write_uint(uint64_t u64)
+{
+    __separate();
+
+    char szBuf[24];
+    char * pEnd = szBuf + sizeof(szBuf);
+    char * pBegin = __formatUInt(pEnd, u64);
+
+    m_str.append(pBegin, pEnd - pBegin);
+    m_bComma = true;
+}
+
+// 输出能精确还原的最短表示；json不能表示无穷大与NaN，输出为null
+inline void JsonWriter::write_double(double d)
+{
+    if (d != d || d - d != 0)
+    {
+        write_null();
+        return;
+    }
+
+    __separate();
+
+    char szBuf[32];
+#if defined(JSON_HAVE_TO_CHARS)
+    char * pEnd = std::to_chars(szBuf, szBuf + sizeof(szBuf), d).ptr;
+    m_str.append(szBuf, pEnd - szBuf);
+#else
+    // 15位有效数字不能精确还原时直接用17位，17位总能还原
+    int n = snprintf(szBuf, sizeof(szBuf), "%.15g", d);
+    if (strtod(szBuf, NULL) != d)
+        n = snprintf(szBuf, sizeof(szBuf), "%.17g", d);
+    JsonReplaceChar(szBuf, n, JsonDecimalPoint(), '.');
+    m_str.append(szBuf, n);
+#endif
+
+    m_bComma = true;
+}
+
+inline void JsonWriter::write_float(float f)
+{
+    if (f != f || f - f != 0)
+    {
+        write_null();
+        return;
+    }
+
+    __separate();
+
+    char szBuf[32];
+#if defined(JSON_HAVE_TO_CHARS)
+    char * pEnd = std::to_chars(szBuf, szBuf + sizeof(szBuf), f).ptr;
+    m_str.append(szBuf, pEnd - szBuf);
+#else
+    int n = snprintf(szBuf, sizeof(szBuf), "%.6g", f);
+    if (float(strtod(szBuf, NULL)) != f)
+        n = snprintf(szBuf, sizeof(szBuf), "%.9g", f);
+    JsonReplaceChar(szBuf, n, JsonDecimalPoint(), '.');
+    m_str.append(szBuf, n);
+#endif
+
+    m_bComma = true;
+}
+
+inline void JsonWriter::write_value(const Json::Value & js)
+{
+    switch (js.type())
+    {
+    case Json::intValue:
+        write_int(js.asLargestInt());
+        break;
+    case Json::uintValue:
+        write_uint(js.asLargestUInt());
+        break;
+    case Json::realValue:
+        write_double(js.asDouble());
+        break;
+    case Json::stringValue:
+    {
+        const char * pBegin = NULL;
+        const char * pEnd = NULL;
+        js.getString(&pBegin, &pEnd);
+        write_string(pBegin, pEnd - pBegin);
+        break;
+    }
+    case Json::booleanValue:
+        write_bool(js.asBool());
+        break;
+    case Json::arrayValue:
+        begin_array();
+        for (Json::ArrayIndex i = 0; i < js.size(); ++i)
+            write_value(js[i]);
+        end_array();
+        break;
+    case Json::objectValue:
+        begin_object();
+        write_members(js);
+        end_object();
+        break;
+    default:
+        write_null();
+        break;
+    }
+}
+
+// 只输出对象的字段，不含外层的大括号
+inline void JsonWriter::write_members(const Json::Value & js)
+{
+    if (js.type() != Json::objectValue)
+        return;
+
+    for (Json::Value::const_iterator i = js.begin(); i != js.end(); ++i)
+    {
+        std::string strKey = i.name();
+        key(strKey.data(), strKey.size());
+        write_value(*i);
+    }
+}
+
+// 无需转义的字节整段追加；支持SSE2时每次检查16字节
+inline void JsonWriter::__string(const char * pData, size_t nSize)
+{
+    m_str += '"';
+
+    const char * p = pData;
+    const char * pEnd = pData + nSize;
+    const char * pRun = pData;
+
+    while (p < pEnd)
+    {
+#if defined(__SSE2__)
+        if (pEnd - p >= 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)p);
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+            // 无符号饱和减法后为0即小于0x20的控制字符
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_subs_epu8(x, _mm_set1_epi8(0x1F)), _mm_setzero_si128()));
+
+            int nMask = _mm_movemask_epi8(m);
+            if (nMask == 0)
+            {
+                p += 16;
+                continue;
+            }
+
+            p += __builtin_ctz(nMask);
+        }
+#endif
+
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            ++p;
+            continue;
+        }
+
+        m_str.append(pRun, p - pRun);
+        __escape(c);
+        pRun = ++p;
+    }
+
+    m_str.append(pRun, p - pRun);
+    m_str += '"';
+}
+
+inline void JsonWriter::__escape(unsigned char c)
+{
+    switch (c)
+    {
+    case '"': m_str.append("\\\"", 2); break;
+    case '\\': m_str.append("\\\\", 2); break;
+    case '\b': m_str.append("\\b", 2); break;
+    case '\f': m_str.append("\\f", 2); break;
+    case '\n': m_str.append("\\n", 2); break;
+    case '\r': m_str.append("\\r", 2); break;
+    case '\t': m_str.append("\\t", 2); break;
+    default:
+    {
+        static const char s_szHex[] = "0123456789abcdef";
+        char szBuf[6] = { '\\', 'u', '0', '0', s_szHex[c >> 4], s_szHex[c & 0xF] };
+        m_str.append(szBuf, 6);
+        break;
+    }
+    }
+}
+
+inline JsonWriter & operator << (JsonWriter & w, bool b) { w.write_bool(b); return w; }
+inline JsonWriter & operator << (JsonWriter & w, uint8_t u8) { w.write_uint(u8); return w; }
+inline JsonWriter & operator << (JsonWriter & w, uint16_t u16) { w.write_uint(u16); return w; }
+inline JsonWriter & operator << (JsonWriter & w, uint32_t u32) { w.write_uint(u32); return w; }
+inline JsonWriter & operator << (JsonWriter & w, int8_t i8) { w.write_int(i8); return w; }
+inline JsonWriter & operator << (JsonWriter & w, int16_t i16) { w.write_int(i16); return w; }
+inline JsonWriter & operator << (JsonWriter & w, int32_t i32) { w.write_int(i32); return w; }
+inline JsonWriter & operator << (JsonWriter & w, uint64_t u64) { w.write_uint(u64); return w; }
+inline JsonWriter & operator << (JsonWriter & w, int64_t i64) { w.write_int(i64); return w; }
+inline JsonWriter & operator << (JsonWriter & w, float f) { w.write_float(f); return w; }
+inline JsonWriter & operator << (JsonWriter & w, double d) { w.write_double(d); return w; }
+inline JsonWriter & operator << (JsonWriter & w, const std::string & str) { w.write_string(str.data(), str.size()); return w; }
+inline JsonWriter & operator << (JsonWriter & w, const char * psz) { w.write_string(psz, strlen(psz)); return w; }
+
+template <typename T>
+inline JsonWriter & operator << (JsonWriter & w, const std::vector<T> & vec)
+{
+    w.begin_array();
+    for (typename std::vector<T>::const_iterator i = vec.begin(); i != vec.end(); ++i)
+        w << (*i);
+    w.end_array();
+    return w;
+}
+
+template <typename T>
+inline JsonWriter & operator << (JsonWriter & w, const std::set<T> & set)
+{
+    w.begin_array();
+    for (typename std::set<T>::const_iterator i = set.begin(); i != set.end(); ++i)
+        w << (*i);
+    w.end_array();
+    return w;
+}
+
+template <typename T>
+inline JsonWriter & operator << (JsonWriter & w, const std::map<std::string, T> & map)
+{
+    w.begin_object();
+    for (typename std::map<std::string, T>::const_iterator i = map.begin(); i != map.end(); ++i)
+        w[i->first] << i->second;
+    w.end_object();
+    return w;
+}
+
+// 流式json读取 =>
+// 单遍扫描输入文本，不构造Json::Value；对象的字段按名字分发，字符串不含转义时直接指向输入，不复制
+
+// 指向输入文本或读取器内部缓冲的字符串，只在下一次读取字符串之前有效
+struct JsonStringPtr
+{
+    const char * m_pData;
+    size_t m_nSize;
+
+    JsonStringPtr() : m_pData(""), m_nSize(0) {}
+
+    void set(const char * pData, size_t nSize)
+    {
+        m_pData = pData;
+        m_nSize = nSize;
+    }
+
+    const char * data() const { return m_pData; }
+    size_t size() const { return m_nSize; }
+    std::string str() const { return std::string(m_pData, m_nSize); }
+
+    bool operator == (const char * psz) const { return (strlen(psz) == m_nSize && memcmp(psz, m_pData, m_nSize) == 0); }
+    bool operator != (const char * psz) const { return !(*this == psz); }
+    bool operator == (const std::string & str) const { return (str.size() == m_nSize && memcmp(str.data(), m_pData, m_nSize) == 0); }
+    bool operator != (const std::string & str) const { return !(*this == str); }
+};
+
+// 读取失败后ok()返回false，之后的读取都直接失败；标量字段遇到null时按0/false/空串处理，与Json::Value一致
+class JsonReader
+{
+private:
+    const char * m_pCur;
+    const char * m_pEnd;
+    size_t m_nDepth;
+    bool m_bFirst;
+    bool m_bError;
+    std::string m_strScratch;
+
+    JsonReader(const JsonReader &);
+    JsonReader & operator = (const JsonReader &);
+
+public:
+    enum { maxDepth = 512 };
+    enum EType { typeInvalid, typeNull, typeBool, typeNumber, typeString, typeArray, typeObject };
+
+    JsonReader(const char * pData, size_t nSize)
+        : m_pCur(pData)
+        , m_pEnd(pData + nSize)
+        , m_nDepth(0)
+        , m_bFirst(false)
+        , m_bError(false)
+    {
+    }
+
+    bool ok() const { return !m_bError; }
+    void set_error() { m_bError = true; m_pCur = m_pEnd; }
+
+    // 当前所在的对象/数组层数
+    size_t depth() const { return m_nDepth; }
+
+    // 跳过空白后是否已到结尾
+    bool eof() { __skipSpace(); return m_pCur == m_pEnd; }
+
+    // 下一个值的类型，不消费输入
+    inline EType peek();
+
+    // 对象与数组：begin_*之后循环调用next_key()/next_item()并读取值，返回false表示已读完结束符或出错
+    bool begin_object() { return __begin('{'); }
+    inline bool next_key(JsonStringPtr & key);
+    bool begin_array() { return __begin('['); }
+    inline bool next_item();
+
+    inline bool read_null();
+    inline bool read_bool(bool & b);
+    inline bool read_int(int64_t & i64);
+    inline bool read_uint(uint64_t & u64);
+    inline bool read_double(double & d);
+    inline bool read_string(JsonStringPtr & str);
+    bool read_string(std::string & str)
+    {
+        JsonStringPtr sp;
+        if (!read_string(sp))
+            return false;
+
+        str.assign(sp.data(), sp.size());
+        return true;
+    }
+
+    // 跳过一个值
+    inline bool skip();
+
+    // 读取为Json::Value，用于尚未实现流式读取的对象
+    inline bool read_value(Json::Value & js);
+    inline bool read_members(Json::Value & js);
+
+private:
+    bool __fail() { set_error(); return false; }
+
+    void __skipSpace()
+    {
+        while (m_pCur < m_pEnd && (*m_pCur == ' ' || *m_pCur == '\n' || *m_pCur == '\r' || *m_pCur == '\t'))
+            ++m_pCur;
+    }
+
+    bool __literal(const char * psz, size_t nSize)
+    {
+        if (size_t(m_pEnd - m_pCur) < nSize || memcmp(m_pCur, psz, nSize) != 0)
+            return false;
+
+        m_pCur += nSize;
+        return true;
+    }
+
+    inline bool __begin(char c);
+    inline bool __separator(char cClose);
+    inline bool __integer(bool & bNegative, uint64_t & u64);
+    inline const char * __number(const char * p) const;
+    inline bool __string(JsonStringPtr & str);
+    inline bool __unescape(const char * & p);
+};
+
+inline JsonReader::EType JsonReader::peek()
+{
+    __skipSpace();
+    if (m_pCur == m_pEnd)
+        return typeInvalid;
+
+    switch (*m_pCur)
+    {
+    case '{': return typeObject;
+    case '[': return typeArray;
+    case '"': return typeString;
+    case 't': case 'f': return typeBool;
+    case 'n': return typeNull;
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9': return typeNumber;
+    default: return typeInvalid;
+    }
+}
+
+inline bool JsonReader::__begin(char c)
+{
+    __skipSpace();
+    if (m_pCur == m_pEnd || *m_pCur != c || m_nDepth >= maxDepth)
+        return __fail();
+
+    ++m_pCur;
+    ++m_nDepth;
+    m_bFirst = true;
+    return true;
+}
+
+// 遇到结束符时消费并返回false；否则除第一个元素外先消费逗号。
+// 结束符之后回到上一层，上一层至少已读过一个元素，所以m_bFirst置为false
+inline bool JsonReader::__separator(char cClose)
+{
+    __skipSpace();
+    if (m_pCur == m_pEnd)
+        return __fail();
+
+    if (*m_pCur == cClose)
+    {
+        ++m_pCur;
+        --m_nDepth;
+        m_bFirst = false;
+        return false;
+    }
+
+    if (!m_bFirst)
+    {
+        if (*m_pCur != ',')
+            return __fail();
+
+        ++m_pCur;
+        __skipSpace();
+    }
+
+    m_bFirst = false;
+    return true;
+}
+
+inline bool JsonReader::next_key(JsonStringPtr & key)
+{
+    if (!__separator('}'))
+        return false;
+
+    if (m_pCur == m_pEnd || *m_pCur != '"' || !__string(key))
+        return __fail();
+
+    __skipSpace();
+    if (m_pCur == m_pEnd || *m_pCur != ':')
+        return __fail();
+
+    ++m_pCur;
+    return true;
+}
+
+inline bool JsonReader::next_item()
+{
+    return __separator(']');
+}
+
+inline bool JsonReader::read_null()
+{
+    __skipSpace();
+    return (__literal("null", 4) || __fail());
+}
+
+inline bool JsonReader::read_bool(bool & b)
+{
+    __skipSpace();
+    if (__literal("true", 4))
+        b = true;
+    else if (__literal("false", 5) || __literal("null", 4))
+        b = false;
+    else
+        return __fail();
+
+    return true;
+}
+
+// 读取整数部分；带小数或指数、或超出64位的数按浮点数读取后截断
+inline bool JsonReader::__integer(bool & bNegative, uint64_t & u64)
+{
+    const char * pBegin = m_pCur;
+    const char * p = m_pCur;
+
+    bNegative = (p < m_pEnd && *p == '-');
+    if (bNegative)
+        ++p;
+
+    const char * pDigits = p;
+    bool bOverflow = false;
+    u64 = 0;
+    for (; p < m_pEnd && *p >= '0' && *p <= '9'; ++p)
+    {
+        unsigned int n = unsigned(*p - '0');
+        if (u64 > (uint64_t(-1) - n) / 10)
+            bOverflow = true;
+
+        u64 = u64 * 10 + n;
+    }
+
+    // 不允许多余的前导0
+    if (p == pDigits || (*pDigits == '0' && p - pDigits > 1))
+        return __fail();
+
+    if (!bOverflow && (p == m_pEnd || (*p != '.' && *p != 'e' && *p != 'E')))
+    {
+        m_pCur = p;
+        return true;
+    }
+
+    m_pCur = pBegin;
+    double d = 0;
+    if (!read_double(d))
+        return false;
+
+    bNegative = (d < 0);
+    if (bNegative)
+        d = -d;
+
+    if (!(d < 18446744073709551616.0))
+        return __fail();
+
+    u64 = uint64_t(d);
+    return true;
+}
+
+inline bool JsonReader::read_int(int64_t & i64)
+{
+    __skipSpace();
+    if (__literal("null", 4))
+    {
+        i64 = 0;
+        return true;
+    }
+
+    bool bNegative = false;
+    uint64_t u64 = 0;
+    if (!__integer(bNegative, u64))
+        return false;
+
+    if (u64 > (bNegative ? uint64_t(1) << 63 : (uint64_t(1) << 63) - 1))
+        return __fail();
+
+    i64 = (bNegative ? int64_t(0 - u64) : int64_t(u64));
+    return true;
+}
+
+inline bool JsonReader::read_uint(uint64_t & u64)
+{
+    __skipSpace();
+    if (__literal("null", 4))
+    {
+        u64 = 0;
+        return true;
+    }
+
+    bool bNegative = false;
+    if (!__integer(bNegative, u64))
+        return false;
+
+    if (bNegative && u64 != 0)
+        return __fail();
+
+    return true;
+}
+
+// 按json的语法 -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? 检查一个数，返回结尾位置，不符合时返回NULL
+inline const char * JsonReader::__number(const char * p) const
+{
+    if (p < m_pEnd && *p == '-')
+        ++p;
+
+    if (p == m_pEnd || *p < '0' || *p > '9')
+        return NULL;
+
+    if (*p++ != '0')
+    {
+        while (p < m_pEnd && *p >= '0' && *p <= '9')
+            ++p;
+    }
+
+    if (p < m_pEnd && *p == '.')
+    {
+        if (++p == m_pEnd || *p < '0' || *p > '9')
+            return NULL;
+
+        while (p < m_pEnd && *p >= '0' && *p <= '9')
+            ++p;
+    }
+
+    if (p < m_pEnd && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        if (p < m_pEnd && (*p == '+' || *p == '-'))
+            ++p;
+
+        if (p == m_pEnd || *p < '0' || *p > '9')
+            return NULL;
+
+        while (p < m_pEnd && *p >= '0' && *p <= '9')
+            ++p;
+    }
+
+    // 数字后紧跟的字符不能继续构成数，例如01、1.2.3
+    if (p < m_pEnd && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E'))
+        return NULL;
+
+    return p;
+}
+
+inline bool JsonReader::read_double(double & d)
+{
+    __skipSpace();
+    if (__literal("null", 4))
+    {
+        d = 0;
+        return true;
+    }
+
+    const char * p = __number(m_pCur);
+    if (p == NULL)
+        return __fail();
+
+#if defined(JSON_HAVE_TO_CHARS)
+    std::from_chars_result res = std::from_chars(m_pCur, p, d);
+    if (res.ec != std::errc() || res.ptr != p)
+        return __fail();
+#else
+    // 输入不保证以0结尾，复制到本地缓冲后再转换
+    size_t nSize = size_t(p - m_pCur);
+    if (nSize >= 64)
+        return __fail();
+
+    char szBuf[64];
+    memcpy(szBuf, m_pCur, nSize);
+    szBuf[nSize] = '\0';
+    JsonReplaceChar(szBuf, nSize, '.', JsonDecimalPoint());
+
+    char * pEnd = NULL;
+    d = strtod(szBuf, &pEnd);
+    if (pEnd != szBuf + nSize || d - d != 0)
+        return __fail();
+#endif
+
+    m_pCur = p;
+    return true;
+}
+
+inline bool JsonReader::read_string(JsonStringPtr & str)
+{
+    __skipSpace();
+    if (__literal("null", 4))
+    {
+        str.set("", 0);
+        return true;
+    }
+
+    if (m_pCur == m_pEnd || *m_pCur != '"')
+        return __fail();
+
+    return __string(str);
+}
+
+// m_pCur指向起始引号；没有转义时直接指向输入，否则解码到m_strScratch。支持SSE2时每次检查16字节；
+// json不允许字符串中出现未转义的控制字符(小于0x20)
+inline bool JsonReader::__string(JsonStringPtr & str)
+{
+    const char * pBegin = ++m_pCur;
+    const char * p = pBegin;
+    bool bEscaped = false;
+
+    for (;;)
+    {
+#if defined(__SSE2__)
+        while (m_pEnd - p >= 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)p);
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_subs_epu8(x, _mm_set1_epi8(0x1F)), _mm_setzero_si128()));
+
+            int nMask = _mm_movemask_epi8(m);
+            if (nMask != 0)
+            {
+                p += __builtin_ctz(nMask);
+                break;
+            }
+            p += 16;
+        }
+#endif
+
+        while (p < m_pEnd && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+            ++p;
+
+        if (p == m_pEnd || (unsigned char)*p < 0x20)
+            return __fail();
+
+        if (*p == '"')
+            break;
+
+        // 第一次遇到转义时把之前的部分复制到内部缓冲
+        if (!bEscaped)
+        {
+            m_strScratch.assign(pBegin, p - pBegin);
+            bEscaped = true;
+        }
+        else
+        {
+            m_strScratch.append(pBegin, p - pBegin);
+        }
+
+        if (!__unescape(p))
+            return false;
+
+        pBegin = p;
+    }
+
+    if (bEscaped)
+    {
+        m_strScratch.append(pBegin, p - pBegin);
+        str.set(m_strScratch.data(), m_strScratch.size());
+    }
+    else
+    {
+        str.set(pBegin, p - pBegin);
+    }
+
+    m_pCur = p + 1;
+    return true;
+}
+
+// p指向反斜杠，解码一个转义序列追加到m_strScratch，\u按UTF-8输出
+inline bool JsonReader::__unescape(const char * & p)
+{
+    if (m_pEnd - p < 2)
+        return __fail();
+
+    char c = p[1];
+    p += 2;
+    switch (c)
+    {
+    case '"': m_strScratch += '"'; return true;
+    case '\\': m_strScratch += '\\'; return true;
+    case '/': m_strScratch += '/'; return true;
+    case 'b': m_strScratch += '\b'; return true;
+    case 'f': m_strScratch += '\f'; return true;
+    case 'n': m_strScratch += '\n'; return true;
+    case 'r': m_strScratch += '\r'; return true;
+    case 't': m_strScratch += '\t'; return true;
+    case 'u': break;
+    default: return __fail();
+    }
+
+    uint32_t nCode = 0;
+    for (int nUnit = 0; ; ++nUnit)
+    {
+        if (m_pEnd - p < 4)
+            return __fail();
+
+        uint32_t nUnitCode = 0;
+        for (int i = 0; i < 4; ++i, ++p)
+        {
+            char h = *p;
+            nUnitCode <<= 4;
+            if (h >= '0' && h <= '9') nUnitCode |= uint32_t(h - '0');
+            else if (h >= 'a' && h <= 'f') nUnitCode |= uint32_t(h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') nUnitCode |= uint32_t(h - 'A' + 10);
+            else return __fail();
+        }
+
+        if (nUnit == 0)
+        {
+            nCode = nUnitCode;
+            if (nCode >= 0xDC00 && nCode <= 0xDFFF)
+                return __fail();
+            if (nCode < 0xD800 || nCode > 0xDBFF)
+                break;
+
+            // 高位代理项后必须紧跟低位代理项
+            if (m_pEnd - p < 2 || p[0] != '\\' || p[1] != 'u')
+                return __fail();
+            p += 2;
+        }
+        else
+        {
+            if (nUnitCode < 0xDC00 || nUnitCode > 0xDFFF)
+                return __fail();
+
+            nCode = 0x10000 + ((nCode - 0xD800) << 10) + (nUnitCode - 0xDC00);
+            break;
+        }
+    }
+
+    if (nCode < 0x80)
+    {
+        m_strScratch += char(nCode);
+    }
+    else if (nCode < 0x800)
+    {
+        m_strScratch += char(0xC0 | (nCode >> 6));
+        m_strScratch += char(0x80 | (nCode & 0x3F));
+    }
+    else if (nCode < 0x10000)
+    {
+        m_strScratch += char(0xE0 | (nCode >> 12));
+        m_strScratch += char(0x80 | ((nCode >> 6) & 0x3F));
+        m_strScratch += char(0x80 | (nCode & 0x3F));
+    }
+    else
+    {
+        m_strScratch += char(0xF0 | (nCode >> 18));
+        m_strScratch += char(0x80 | ((nCode >> 12) & 0x3F));
+        m_strScratch += char(0x80 | ((nCode >> 6) & 0x3F));
+        m_strScratch += char(0x80 | (nCode & 0x3F));
+    }
+
+    return true;
+}
+
+inline bool JsonReader::skip()
+{
+    switch (peek())
+    {
+    case typeNull:
+        return read_null();
+    case typeBool:
+    {
+        bool b;
+        return read_bool(b);
+    }
+    case typeNumber:
+    {
+        double d;
+        return read_double(d);
+    }
+    case typeString:
+    {
+        JsonStringPtr str;
+        return __string(str);
+    }
+    case typeArray:
+        begin_array();
+        while (next_item())
+        {
+            if (!skip())
+                return false;
+        }
+        return ok();
+    case typeObject:
+    {
+        JsonStringPtr key;
+        begin_object();
+        while (next_key(key))
+        {
+            if (!skip())
+                return false;
+        }
+        return ok();
+    }
+    default:
+        return __fail();
+    }
+}
+
+inline bool JsonReader::read_value(Json::Value & js)
+{
+    switch (peek())
+    {
+    case typeNull:
+        js = Json::Value();
+        return read_null();
+    case typeBool:
+    {
+        bool b = false;
+        if (!read_bool(b))
+            return false;
+        js = b;
+        return true;
+    }
+    case typeNumber:
+    {
+        // 整数保持整数类型，与Json::Reader一致；带小数或指数的数、超出64位整数范围的整数与-0按浮点数保存
+        const char * pEnd = __number(m_pCur);
+        if (pEnd == NULL)
+            return __fail();
+
+        const char * p = m_pCur;
+        bool bNegative = (*p == '-');
+        if (bNegative)
+            ++p;
+
+        uint64_t u64 = 0;
+        bool bReal = (bNegative && pEnd - p == 1 && *p == '0');
+        for (; !bReal && p < pEnd; ++p)
+        {
+            if (*p < '0' || *p > '9')
+            {
+                bReal = true;
+                break;
+            }
+
+            unsigned int n = unsigned(*p - '0');
+            if (u64 > (uint64_t(-1) - n) / 10)
+            {
+                bReal = true;
+                break;
+            }
+            u64 = u64 * 10 + n;
+        }
+
+        if (bReal || (bNegative && u64 > uint64_t(1) << 63))
+        {
+            double d = 0;
+            if (!read_double(d))
+                return false;
+            js = d;
+            return true;
+        }
+
+        // Json::Reader把超过maxInt的非负整数保存为无符号类型
+        m_pCur = pEnd;
+        if (bNegative)
+        {
+            js = Json::LargestInt(0 - u64);
+        }
+        else if (u64 <= uint64_t(Json::Value::maxInt))
+        {
+            js = Json::LargestInt(u64);
+        }
+        else
+        {
+            js = Json::LargestUInt(u64);
+        }
+        return true;
+    }
+    case typeString:
+    {
+        JsonStringPtr str;
+        if (!__string(str))
+            return false;
+        js = Json::Value(str.data(), str.data() + str.size());
+        return true;
+    }
+    case typeArray:
+        js = Json::Value(Json::arrayValue);
+        begin_array();
+        while (next_item())
+        {
+            if (!read_value(js.append(Json::Value())))
+                return false;
+        }
+        return ok();
+    case typeObject:
+        js = Json::Value(Json::objectValue);
+        begin_object();
+        return read_members(js);
+    default:
+        return __fail();
+    }
+}
+
+// 在begin_object()之后读取剩余的字段，直到对象结束
+inline bool JsonReader::read_members(Json::Value & js)
+{
+    JsonStringPtr key;
+    while (next_key(key))
+    {
+        if (!read_value(js[key.str()]))
+            return false;
+    }
+    return ok();
+}
+
+// 整数读取后检查目标类型的范围，超出范围视为错误
+template <typename T>
+inline JsonReader & JsonReadUInt(JsonReader & r, T & t, uint64_t nMax)
+{
+    uint64_t u64 = 0;
+    if (r.read_uint(u64))
+    {
+        if (u64 > nMax)
+            r.set_error();
+        else
+            t = T(u64);
+    }
+    return r;
+}
+
+template <typename T>
+inline JsonReader & JsonReadInt(JsonReader & r, T & t, int64_t nMin, int64_t nMax)
+{
+    int64_t i64 = 0;
+    if (r.read_int(i64))
+    {
+        if (i64 < nMin || i64 > nMax)
+            r.set_error();
+        else
+            t = T(i64);
+    }
+    return r;
+}
+
+inline JsonReader & operator >> (JsonReader & r, bool & b) { r.read_bool(b); return r; }
+inline JsonReader & operator >> (JsonReader & r, uint8_t & u8) { return JsonReadUInt(r, u8, 0xFF); }
+inline JsonReader & operator >> (JsonReader & r, uint16_t & u16) { return JsonReadUInt(r, u16, 0xFFFF); }
+inline JsonReader & operator >> (JsonReader & r, uint32_t & u32) { return JsonReadUInt(r, u32, 0xFFFFFFFFu); }
+inline JsonReader & operator >> (JsonReader & r, int8_t & i8) { return JsonReadInt(r, i8, -0x80, 0x7F); }
+inline JsonReader & operator >> (JsonReader & r, int16_t & i16) { return JsonReadInt(r, i16, -0x8000, 0x7FFF); }
+inline JsonReader & operator >> (JsonReader & r, int32_t & i32) { return JsonReadInt(r, i32, -0x7FFFFFFF - 1, 0x7FFFFFFF); }
+inline JsonReader & operator >> (JsonReader & r, uint64_t & u64) { r.read_uint(u64); return r; }
+inline JsonReader & operator >> (JsonReader & r, int64_t & i64) { r.read_int(i64); return r; }
+inline JsonReader & operator >> (JsonReader & r, float & f) { double d = 0; if (r.read_double(d) && !JsonDoubleToFloat(d, f)) r.set_error(); return r; }
+inline JsonReader & operator >> (JsonReader & r, double & d) { r.read_double(d); return r; }
+inline JsonReader & operator >> (JsonReader & r, std::string & str) { r.read_string(str); return r; }
+
+// 容器元素直接在目标容器中构造后读取，null按空容器处理
+
+template <typename T>
+inline JsonReader & operator >> (JsonReader & r, std::vector<T> & vec)
+{
+    if (r.peek() == JsonReader::typeNull)
+    {
+        r.read_null();
+        return r;
+    }
+
+    r.begin_array();
+    while (r.next_item())
+    {
+        vec.push_back(T());
+        r >> vec.back();
+    }
+    return r;
+}
+
+template <typename T>
+inline JsonReader & operator >> (JsonReader & r, std::set<T> & set)
+{
+    if (r.peek() == JsonReader::typeNull)
+    {
+        r.read_null();
+        return r;
+    }
+
+    r.begin_array();
+    while (r.next_item())
+    {
+        T t;
+        r >> t;
+        set.insert(set.end(), t);
+    }
+    return r;
+}
+
+template <typename T>
+inline JsonReader & operator >> (JsonReader & r, std::map<std::string, T> & map)
+{
+    if (r.peek() == JsonReader::typeNull)
+    {
+        r.read_null();
+        return r;
+    }
+
+    JsonStringPtr key;
+    r.begin_object();
+    while (r.next_key(key))
+    {
+        // 按顺序到来的键直接插入到尾部
+        r >> map.insert(map.end(), std::make_pair(key.str(), T()))->second;
+    }
+    return r;
+}
+
 // 结构类型的序列化与反序列化 =>
 
 struct JsonMarshallable
@@ -193,20 +1449,116 @@ struct JsonMarshallable
 
     virtual void marshal(Json::Value &) const = 0;
     virtual void unmarshal(const Json::Value &) = 0;
+
+    // 流式输出对象的字段(外层大括号由调用者输出)，默认先构造Json::Value再输出；
+    // 与marshal(Json::Value &)不同名，以免只重写其一的派生类隐藏另一个重载
+    virtual void marshal_stream(JsonWriter & w) const
+    {
+        Json::Value js;
+        marshal(js);
+        w.write_members(js);
+    }
+
+    // 流式读取对象的字段(外层大括号由调用者读取)，默认先读取为Json::Value再解析
+    virtual void unmarshal_stream(JsonReader & r)
+    {
+        Json::Value js(Json::objectValue);
+        r.read_members(js);
+        unmarshal(js);
+    }
 };
 
-Json::Value & operator << (Json::Value & js, const JsonMarshallable & obj)
+inline Json::Value & operator << (Json::Value & js, const JsonMarshallable & obj)
 {
     obj.marshal(js);
     return js;
 }
 
-const Json::Value & operator >> (const Json::Value & js, JsonMarshallable & obj)
+inline const Json::Value & operator >> (const Json::Value & js, JsonMarshallable & obj)
 {
     obj.unmarshal(js);
     return js;
 }
 
+inline JsonWriter & operator << (JsonWriter & w, const JsonMarshallable & obj)
+{
+    w.begin_object();
+    obj.marshal_stream(w);
+    w.end_object();
+    return w;
+}
+
+// 对象的unmarshal_stream()没有读完的字段会被跳过
+inline JsonReader & operator >> (JsonReader & r, JsonMarshallable & obj)
+{
+    if (r.peek() == JsonReader::typeNull)
+    {
+        r.read_null();
+        return r;
+    }
+
+    size_t nDepth = r.depth();
+    if (!r.begin_object())
+        return r;
+
+    obj.unmarshal_stream(r);
+
+    JsonStringPtr key;
+    while (r.depth() > nDepth && r.next_key(key))
+        r.skip();
+
+    return r;
+}
+
+// 在unmarshal_stream()中按字段名分发，未列出的字段被跳过：
+//     JSON_READ_BEGIN(r)
+//         JSON_READ_FIELD("name", strName)
+//         JSON_READ_FIELD("age", nAge)
+//     JSON_READ_END()
+#define JSON_READ_BEGIN(r) \
+    { \
+        dakuang::JsonReader & jsonReader_ = (r); \
+        dakuang::JsonStringPtr jsonKey_; \
+        while (jsonReader_.next_key(jsonKey_)) \
+        {
+#define JSON_READ_FIELD(name, field) \
+            if (jsonKey_ == name) { jsonReader_ >> field; continue; }
+#define JSON_READ_END() \
+            jsonReader_.skip(); \
+        } \
+    }
+
+// 将对象流式输出为紧凑格式的json字符串
+inline void Object2Json(const JsonMarshallable & obj, std::string & str)
+{
+    str.clear();
+
+    JsonWriter w(str);
+    w << obj;
+}
+
+// 从json文本流式读取对象，要求整个文本是一个对象；
+// 保留catch只为兼容默认实现中Json::Value类型不符时抛出的异常
+inline bool Json2Object(const char * pData, size_t nSize, JsonMarshallable & obj)
+{
+    try
+    {
+        JsonReader r(pData, nSize);
+        r >> obj;
+
+        return (r.ok() && r.eof());
+    }
+    catch (const std::exception & e)
+    {
+        return false;
+    }
+}
+
+inline bool Json2Object(const std::string & str, JsonMarshallable & obj)
+{
+    return Json2Object(str.data(), str.size(), obj);
+}
+
 }
 
 #endif // JSONMARSHAL_H
@@ -4,34 +4,50 @@
 // 简单结构体序列化实现 =》
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
 
+#include "../dstypes.h"
+
 namespace dakuang
 {
 
 // 本地字节序 -> 网络字节序
-inline uint16_t HTONS(uint16_t u16)
-{
-    return ( (u16 << 8) | (u16 >> 8) );
-}
-inline uint32_t HTONL(uint32_t u32)
-{
-    return ( (uint32_t(HTONS(uint16_t(u32))) << 16) | HTONS(uint16_t(u32 >> 16)) );
-}
-inline uint64_t HTONLL(uint64_t u64)
-{
-    return ( (uint64_t(HTONL(uint32_t(u64))) << 32) | HTONL(uint32_t(u64 >> 32)) );
-}
+#ifdef DS_HOST_BIG_ENDIAN
+inline uint16_t HTONS(uint16_t u16) { return u16; }
+inline uint32_t HTONL(uint32_t u32) { return u32; }
+inline uint64_t HTONLL(uint64_t u64) { return u64; }
+#else
+inline uint16_t HTONS(uint16_t u16) { return DS_BSWAP16(u16); }
+inline uint32_t HTONL(uint32_t u32) { return DS_BSWAP32(u32); }
+inline uint64_t HTONLL(uint64_t u64) { return DS_BSWAP64(u64); }
+#endif
 
 // 网络字节序 -> 本地字节序
 #define NTOHS HTONS
 #define NTOHL HTONL
 #define NTOHLL HTONLL
 
+// 本地字节序 <-> 线上字节序，与dspacket.h相同，定义DS_WIRE_LITTLE_ENDIAN时线上采用小端
+#if defined(DS_WIRE_LITTLE_ENDIAN) && !defined(DS_HOST_BIG_ENDIAN)
+inline uint16_t WIRE16(uint16_t u16) { return u16; }
+inline uint32_t WIRE32(uint32_t u32) { return u32; }
+inline uint64_t WIRE64(uint64_t u64) { return u64; }
+#elif defined(DS_WIRE_LITTLE_ENDIAN)
+inline uint16_t WIRE16(uint16_t u16) { return DS_BSWAP16(u16); }
+inline uint32_t WIRE32(uint32_t u32) { return DS_BSWAP32(u32); }
+inline uint64_t WIRE64(uint64_t u64) { return DS_BSWAP64(u64); }
+#else
+inline uint16_t WIRE16(uint16_t u16) { return HTONS(u16); }
+inline uint32_t WIRE32(uint32_t u32) { return HTONL(u32); }
+inline uint64_t WIRE64(uint64_t u64) { return HTONLL(u64); }
+#endif
+
 // 定义序列化操作类
 class SimplePack
 {
@@ -42,9 +58,9 @@ private:
     SimplePack & operator = (const SimplePack& o);
 
 public:
-    static uint16_t xhtons(uint16_t u16) { return HTONS(u16); }
-    static uint32_t xhtonl(uint32_t u32) { return HTONL(u32); }
-    static uint64_t xhtonll(uint64_t u64) { return HTONLL(u64); }
+    static uint16_t xhtons(uint16_t u16) { return WIRE16(u16); }
+    static uint32_t xhtonl(uint32_t u32) { return WIRE32(u32); }
+    static uint64_t xhtonll(uint64_t u64) { return WIRE64(u64); }
 
     SimplePack() {}
     virtual ~SimplePack() {}
@@ -62,6 +78,38 @@ public:
     SimplePack & push_uint16(uint16_t u16) { u16 = xhtons(u16); return push(&u16, 2); }
     SimplePack & push_uint32(uint32_t u32) { u32 = xhtonl(u32); return push(&u32, 4); }
     SimplePack & push_uint64(uint64_t u64) { u64 = xhtonll(u64); return push(&u64, 8); }
+
+    // 浮点数按位复制为同宽度的整数后转换字节序
+    SimplePack & push_float(float f) { uint32_t u32; memcpy(&u32, &f, 4); return push_uint32(u32); }
+    SimplePack & push_double(double d) { uint64_t u64; memcpy(&u64, &d, 8); return push_uint64(u64); }
+
+    // 批量压入浮点数组，一次扩展缓冲区后逐个转换
+    SimplePack & push_float_array(const float * pData, size_t nCount)
+    {
+        size_t nPos = m_strBuffer.size();
+        m_strBuffer.resize(nPos + nCount * 4);
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            uint32_t u32;
+            memcpy(&u32, pData + i, 4);
+            u32 = xhtonl(u32);
+            memcpy(&m_strBuffer[nPos + i * 4], &u32, 4);
+        }
+        return *this;
+    }
+    SimplePack & push_double_array(const double * pData, size_t nCount)
+    {
+        size_t nPos = m_strBuffer.size();
+        m_strBuffer.resize(nPos + nCount * 8);
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            uint64_t u64;
+            memcpy(&u64, pData + i, 8);
+            u64 = xhtonll(u64);
+            memcpy(&m_strBuffer[nPos + i * 8], &u64, 8);
+        }
+        return *this;
+    }
     SimplePack & push_string(const void * pData, size_t nSize)
     {
         if (nSize > 0xFFFF) throw std::runtime_error("[SimplePack::push_string] string too big");
@@ -95,9 +143,9 @@ private:
     mutable size_t m_nSize;
 
 public:
-    static uint16_t xntohs(uint16_t u16) { return NTOHS(u16); }
-    static uint32_t xntohl(uint32_t u32) { return NTOHL(u32); }
-    static uint64_t xntohll(uint64_t u64) { return NTOHLL(u64); }
+    static uint16_t xntohs(uint16_t u16) { return WIRE16(u16); }
+    static uint32_t xntohl(uint32_t u32) { return WIRE32(u32); }
+    static uint64_t xntohll(uint64_t u64) { return WIRE64(u64); }
 
     SimpleUnpack(const void * pData, size_t nSize)
     {
@@ -144,10 +192,43 @@ public:
         return pData;
     }
 
-    uint8_t pop_uint8(bool bPeek = false) const { return *(uint8_t*)pop_fetch_ptr(1, bPeek); }
-    uint16_t pop_uint16(bool bPeek = false) const { uint16_t u16 = *(uint16_t*)pop_fetch_ptr(2, bPeek); return xntohs(u16); }
-    uint32_t pop_uint32(bool bPeek = false) const { uint32_t u32 = *(uint32_t*)pop_fetch_ptr(4, bPeek); return xntohl(u32); }
-    uint64_t pop_uint64(bool bPeek = false) const { uint64_t u64 = *(uint64_t*)pop_fetch_ptr(8, bPeek); return xntohll(u64); }
+    // 数据可能不对齐，统一用memcpy读取
+    uint8_t pop_uint8(bool bPeek = false) const { return *(const uint8_t*)pop_fetch_ptr(1, bPeek); }
+    uint16_t pop_uint16(bool bPeek = false) const { uint16_t u16; memcpy(&u16, pop_fetch_ptr(2, bPeek), 2); return xntohs(u16); }
+    uint32_t pop_uint32(bool bPeek = false) const { uint32_t u32; memcpy(&u32, pop_fetch_ptr(4, bPeek), 4); return xntohl(u32); }
+    uint64_t pop_uint64(bool bPeek = false) const { uint64_t u64; memcpy(&u64, pop_fetch_ptr(8, bPeek), 8); return xntohll(u64); }
+    float pop_float(bool bPeek = false) const { uint32_t u32 = pop_uint32(bPeek); float f; memcpy(&f, &u32, 4); return f; }
+    double pop_double(bool bPeek = false) const { uint64_t u64 = pop_uint64(bPeek); double d; memcpy(&d, &u64, 8); return d; }
+
+    // 批量解出浮点数组，先检查长度以免乘法溢出
+    void pop_float_array(float * pData, size_t nCount) const
+    {
+        if (nCount > m_nSize / 4)
+            throw std::runtime_error("[SimpleUnpack::pop_float_array] not enough data");
+
+        const char * pSrc = pop_fetch_ptr(nCount * 4);
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            uint32_t u32;
+            memcpy(&u32, pSrc + i * 4, 4);
+            u32 = xntohl(u32);
+            memcpy(pData + i, &u32, 4);
+        }
+    }
+    void pop_double_array(double * pData, size_t nCount) const
+    {
+        if (nCount > m_nSize / 8)
+            throw std::runtime_error("[SimpleUnpack::pop_double_array] not enough data");
+
+        const char * pSrc = pop_fetch_ptr(nCount * 8);
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            uint64_t u64;
+            memcpy(&u64, pSrc + i * 8, 8);
+            u64 = xntohll(u64);
+            memcpy(pData + i, &u64, 8);
+        }
+    }
 
     const char * pop_string(size_t & nSize) const
     {
@@ -230,6 +311,18 @@ inline SimplePack & operator << (SimplePack & p, int64_t i64)
     return p;
 }
 
+inline SimplePack & operator << (SimplePack & p, float f)
+{
+    p.push_float(f);
+    return p;
+}
+
+inline SimplePack & operator << (SimplePack & p, double d)
+{
+    p.push_double(d);
+    return p;
+}
+
 inline SimplePack & operator << (SimplePack & p, const std::string & str)
 {
     p.push_string(str.data(), str.size());
@@ -290,6 +383,18 @@ inline const SimpleUnpack & operator >> (const SimpleUnpack & up, int64_t & i64)
     return up;
 }
 
+inline const SimpleUnpack & operator >> (const SimpleUnpack & up, float & f)
+{
+    f = up.pop_float();
+    return up;
+}
+
+inline const SimpleUnpack & operator >> (const SimpleUnpack & up, double & d)
+{
+    d = up.pop_double();
+    return up;
+}
+
 inline const SimpleUnpack & operator >> (const SimpleUnpack & up, std::string & str)
 {
     size_t nSize = 0;
@@ -370,6 +475,50 @@ inline const SimpleUnpack & operator >> (const SimpleUnpack & up, std::vector<T>
     return up;
 }
 
+// 浮点数组批量处理，格式与逐个处理相同
+
+inline SimplePack & operator << (SimplePack & p, const std::vector<float> & vec)
+{
+    p.push_uint32(uint32_t(vec.size()));
+    if (!vec.empty())
+        p.push_float_array(&vec[0], vec.size());
+    return p;
+}
+
+inline SimplePack & operator << (SimplePack & p, const std::vector<double> & vec)
+{
+    p.push_uint32(uint32_t(vec.size()));
+    if (!vec.empty())
+        p.push_double_array(&vec[0], vec.size());
+    return p;
+}
+
+inline const SimpleUnpack & operator >> (const SimpleUnpack & up, std::vector<float> & vec)
+{
+    size_t nCount = up.pop_uint32();
+    if (nCount > up.size() / 4)
+        throw std::runtime_error("[SimpleUnpack::operator >>] not enough data");
+
+    size_t nOldSize = vec.size();
+    vec.resize(nOldSize + nCount);
+    if (nCount > 0)
+        up.pop_float_array(&vec[nOldSize], nCount);
+    return up;
+}
+
+inline const SimpleUnpack & operator >> (const SimpleUnpack & up, std::vector<double> & vec)
+{
+    size_t nCount = up.pop_uint32();
+    if (nCount > up.size() / 8)
+        throw std::runtime_error("[SimpleUnpack::operator >>] not enough data");
+
+    size_t nOldSize = vec.size();
+    vec.resize(nOldSize + nCount);
+    if (nCount > 0)
+        up.pop_double_array(&vec[nOldSize], nCount);
+    return up;
+}
+
 template <class T>
 inline SimplePack & operator << (SimplePack & p, const std::set<T> & set)
 {
@@ -0,0 +1,199 @@
+// DSFrameDecoder的socketpair测试 =>
+// 编译：g++ -std=c++11 -O2 -I. test/dsframe_test.cpp -pthread -o dsframe_test
+// 运行：./dsframe_test，全部通过时返回0
+// 发送端把帧按随机长度拆分或合并后写入socketpair，接收端recv()直接写入解码器的尾部，
+// 检查每帧都完整解出、视图指向解码器自身的缓冲区，并且除recv()外搬移的数据远少于收到的数据
+
+#define DS_ENABLE_STATS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <thread>
+
+#include "dsframe.h"
+
+using namespace dakuang;
+
+static int g_nFailed = 0;
+
+#define TEST_CHECK(cond) \
+    do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++g_nFailed; } } while (0)
+
+struct SMsg : public Marshallable
+{
+    uint32_t nSeq;
+    std::string strBody;
+
+    virtual void marshal(DSPack & p) const { p << nSeq << strBody; }
+    virtual void unmarshal(const DSUnpack & up) { up >> nSeq >> strBody; }
+};
+
+static uint32_t test_rand(uint32_t & nSeed)
+{
+    nSeed = nSeed * 1103515245 + 12345;
+    return (nSeed >> 8);
+}
+
+static void test_fill(SMsg & msg, uint32_t nSeq)
+{
+    uint32_t nSeed = nSeq + 1;
+    msg.nSeq = nSeq;
+    msg.strBody.assign(test_rand(nSeed) % 3000, char('a' + nSeq % 26));
+}
+
+// 全部帧先序列化到一个缓冲区，再按随机长度写出：小于一帧时帧被拆分，大于一帧时多帧合并
+static void test_send(int fd, const DSPackBuffer & buffer, uint32_t nMaxChunk)
+{
+    const char * pData = const_cast<DSPackBuffer &>(buffer).data();
+    size_t nLeft = buffer.size();
+    uint32_t nSeed = 7;
+    while (nLeft > 0)
+    {
+        size_t nChunk = 1 + test_rand(nSeed) % nMaxChunk;
+        if (nChunk > nLeft)
+            nChunk = nLeft;
+
+        ssize_t n = write(fd, pData, nChunk);
+        if (n <= 0)
+            break;
+
+        pData += n;
+        nLeft -= n;
+    }
+    close(fd);
+}
+
+static void test_socketpair(uint32_t nFrames, uint32_t nMaxChunk)
+{
+    int fds[2];
+    TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    DSPackBuffer buffer;
+    for (uint32_t i = 0; i < nFrames; ++i)
+    {
+        SMsg msg;
+        test_fill(msg, i);
+        Object2Frame(msg, buffer);
+    }
+
+    std::thread sender(test_send, fds[0], std::ref(buffer), nMaxChunk);
+
+    DSStatsReset();
+
+    DSFrameDecoder decoder;
+    DSUnpack up(NULL, 0);
+    uint32_t nSeq = 0;
+    size_t nRecv = 0;
+    for (;;)
+    {
+        char * p = decoder.prepare(4096);
+        TEST_CHECK(p != NULL);
+
+        ssize_t n = recv(fds[1], p, decoder.writable(), 0);
+        if (n <= 0)
+            break;
+        TEST_CHECK(decoder.commit(n));
+        nRecv += n;
+
+        for (;;)
+        {
+            const char * pHead = decoder.data();
+            if (!decoder.next(up))
+                break;
+
+            // 视图直接指向解码器的缓冲区
+            TEST_CHECK(up.data() == pHead + DSFrameDecoder::headerSize);
+
+            SMsg msg, expect;
+            up >> msg;
+            up.finish();
+            test_fill(expect, nSeq);
+            TEST_CHECK(msg.nSeq == expect.nSeq && msg.strBody == expect.strBody);
+            ++nSeq;
+        }
+        TEST_CHECK(!decoder.bad());
+    }
+
+    sender.join();
+    close(fds[1]);
+
+    const SDSStats & stats = DSStatsLocal();
+    size_t nMoved = size_t(stats.nCompactBytes + stats.nGrowCopyBytes);
+
+    TEST_CHECK(nSeq == nFrames);
+    TEST_CHECK(nRecv == buffer.size());
+    TEST_CHECK(decoder.size() == 0);
+    // 只有缓冲区尾部不足时才搬移未完成的一帧，搬移量远小于收到的数据
+    TEST_CHECK(nMoved * 4 < nRecv);
+
+    printf("socketpair: frames=%u max_chunk=%u bytes=%zu moved=%zu\n", nFrames, nMaxChunk, nRecv, nMoved);
+}
+
+// 逐字节写入，每个字节都可能是帧的边界
+static void test_byte_by_byte()
+{
+    DSPackBuffer buffer;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        SMsg msg;
+        test_fill(msg, i);
+        Object2Frame(msg, buffer);
+    }
+
+    DSFrameDecoder decoder;
+    DSUnpack up(NULL, 0);
+    uint32_t nSeq = 0;
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        TEST_CHECK(decoder.feed(buffer.data() + i, 1));
+        while (decoder.next(up))
+        {
+            SMsg msg;
+            up >> msg;
+            TEST_CHECK(msg.nSeq == nSeq);
+            ++nSeq;
+        }
+    }
+
+    TEST_CHECK(nSeq == 200);
+    TEST_CHECK(decoder.size() == 0);
+}
+
+// 帧长超过上限后进入bad()状态，不再解出任何帧
+static void test_max_frame_size()
+{
+    DSPackBuffer buffer;
+    SMsg msg;
+    msg.nSeq = 1;
+    msg.strBody.assign(2000, 'x');
+    Object2Frame(msg, buffer);
+
+    DSFrameDecoder decoder(1024);
+    DSUnpack up(NULL, 0);
+    TEST_CHECK(decoder.feed(buffer.data(), buffer.size()));
+    TEST_CHECK(!decoder.next(up));
+    TEST_CHECK(decoder.bad());
+
+    decoder.clear();
+    TEST_CHECK(!decoder.bad());
+}
+
+int main()
+{
+    test_socketpair(20000, 7000);
+    test_socketpair(20000, 64);
+    test_socketpair(2000, 256 * 1024);
+    test_byte_by_byte();
+    test_max_frame_size();
+
+    if (g_nFailed != 0)
+    {
+        printf("%d check(s) failed\n", g_nFailed);
+        return 1;
+    }
+
+    printf("all passed\n");
+    return 0;
+}
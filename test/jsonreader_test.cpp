@@ -0,0 +1,266 @@
+// JsonReader的测试 =>
+// 编译：g++ -std=c++11 -O2 -I. -I/usr/include/jsoncpp test/jsonreader_test.cpp -ljsoncpp -o jsonreader_test
+// 运行：./jsonreader_test，全部通过时返回0
+// 覆盖语法检查、\u转义与代理对、嵌套层数上限、数值范围，以及流式读取与Json::Value方式结果一致
+
+#include <stdio.h>
+#include <math.h>
+
+#include "jsonmarshal/jsonmarshal.h"
+
+using namespace dakuang;
+
+static int g_nFailed = 0;
+
+#define TEST_CHECK(cond) \
+    do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++g_nFailed; } } while (0)
+
+// 流式读取的对象，字段按名字分发
+struct SStream : public JsonMarshallable
+{
+    int32_t i32;
+    uint32_t u32;
+    int64_t i64;
+    uint64_t u64;
+    float f;
+    double d;
+    bool b;
+    std::string s;
+    std::vector<int32_t> vec;
+    std::map<std::string, std::string> m;
+
+    SStream() : i32(0), u32(0), i64(0), u64(0), f(0), d(0), b(false) {}
+
+    virtual void marshal(Json::Value & js) const
+    {
+        js["i32"] << i32; js["u32"] << u32; js["i64"] << i64; js["u64"] << u64;
+        js["f"] << f; js["d"] << d; js["b"] << b; js["s"] << s; js["vec"] << vec; js["m"] << m;
+    }
+    virtual void unmarshal(const Json::Value & js)
+    {
+        js["i32"] >> i32; js["u32"] >> u32; js["i64"] >> i64; js["u64"] >> u64;
+        js["f"] >> f; js["d"] >> d; js["b"] >> b; js["s"] >> s; js["vec"] >> vec; js["m"] >> m;
+    }
+    virtual void marshal_stream(JsonWriter & w) const
+    {
+        w["i32"] << i32; w["u32"] << u32; w["i64"] << i64; w["u64"] << u64;
+        w["f"] << f; w["d"] << d; w["b"] << b; w["s"] << s; w["vec"] << vec; w["m"] << m;
+    }
+    virtual void unmarshal_stream(JsonReader & r)
+    {
+        JSON_READ_BEGIN(r)
+            JSON_READ_FIELD("i32", i32)
+            JSON_READ_FIELD("u32", u32)
+            JSON_READ_FIELD("i64", i64)
+            JSON_READ_FIELD("u64", u64)
+            JSON_READ_FIELD("f", f)
+            JSON_READ_FIELD("d", d)
+            JSON_READ_FIELD("b", b)
+            JSON_READ_FIELD("s", s)
+            JSON_READ_FIELD("vec", vec)
+            JSON_READ_FIELD("m", m)
+        JSON_READ_END()
+    }
+
+    bool operator == (const SStream & o) const
+    {
+        return (i32 == o.i32 && u32 == o.u32 && i64 == o.i64 && u64 == o.u64 && f == o.f && d == o.d &&
+                b == o.b && s == o.s && vec == o.vec && m == o.m);
+    }
+};
+
+// 未实现流式读取的对象，走默认的Json::Value路径
+struct SDom : public JsonMarshallable
+{
+    Json::Value js;
+
+    virtual void marshal(Json::Value & o) const { o = js; }
+    virtual void unmarshal(const Json::Value & o) { js = o; }
+};
+
+static bool test_stream(const char * psz)
+{
+    SStream obj;
+    return Json2Object(std::string(psz), obj);
+}
+
+static bool test_dom(const char * psz)
+{
+    SDom obj;
+    return Json2Object(std::string(psz), obj);
+}
+
+// 不符合json语法的输入，流式与默认路径都应拒绝
+static void test_grammar()
+{
+    const char * arrBad[] = {
+        "{\"i32\":01}", "{\"d\":.5}", "{\"d\":-.5}", "{\"d\":1.}", "{\"d\":1e}", "{\"d\":1e+}",
+        "{\"d\":+1}", "{\"d\":1.2.3}", "{\"d\":--1}", "{\"d\":-}", "{\"d\":0x10}", "{\"d\":NaN}",
+        "{\"s\":\"a\x1b\"}", "{\"s\":\"a\nb\"}", "{\"s\":\"0123456789abcdef\tghij\"}",
+        "{\"s\":\"abc}", "{\"s\":\"\\x\"}", "{\"s\":\"\\u12\"}",
+        "{\"i32\":1,}", "{,}", "{\"i32\" 1}", "{\"i32\":1 \"u32\":2}", "{\"vec\":[1,]}", "{\"vec\":[1 2]}",
+        "{\"b\":tru}", "{\"b\":nul}", "{'s':1}", "{\"i32\":1}}", "{\"i32\":1} x", "",
+    };
+    for (size_t i = 0; i < sizeof(arrBad) / sizeof(arrBad[0]); ++i)
+    {
+        if (test_stream(arrBad[i]) || test_dom(arrBad[i]))
+        {
+            printf("accepted: %s\n", arrBad[i]);
+            ++g_nFailed;
+        }
+    }
+
+    const char * arrGood[] = {
+        "{}", " { } ", "{\"i32\":0}", "{\"i32\":-0}", "{\"d\":0.5}", "{\"d\":-1.5e-3}", "{\"d\":1E+2}",
+        "{\"d\":0e0}", "{\"s\":\"\"}", "{\"s\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"}", "{\"s\":null}",
+        "{\"unknown\":{\"a\":[1,2.5,-0.0,true,false,null,\"x\",{}]},\"i32\":1}",
+        "{\"vec\":[]}", "{\"m\":{}}", "{\"s\":\"\xe4\xb8\xad\xe6\x96\x87\"}",
+    };
+    for (size_t i = 0; i < sizeof(arrGood) / sizeof(arrGood[0]); ++i)
+    {
+        if (!test_stream(arrGood[i]) || !test_dom(arrGood[i]))
+        {
+            printf("rejected: %s\n", arrGood[i]);
+            ++g_nFailed;
+        }
+    }
+}
+
+// \u转义按UTF-8输出，代理对合并为一个码点，落单的代理项被拒绝
+static void test_unicode()
+{
+    SStream obj;
+    TEST_CHECK(Json2Object(std::string("{\"s\":\"\\u0041\\u00e9\\u4e2d\"}"), obj));
+    TEST_CHECK(obj.s == "A\xc3\xa9\xe4\xb8\xad");
+
+    TEST_CHECK(Json2Object(std::string("{\"s\":\"\\ud83d\\ude00\"}"), obj));
+    TEST_CHECK(obj.s == "\xf0\x9f\x98\x80");
+
+    TEST_CHECK(Json2Object(std::string("{\"s\":\"\\u0000x\"}"), obj));
+    TEST_CHECK(obj.s == std::string("\0x", 2));
+
+    TEST_CHECK(!test_stream("{\"s\":\"\\ud83d\"}"));
+    TEST_CHECK(!test_stream("{\"s\":\"\\ud83dx\"}"));
+    TEST_CHECK(!test_stream("{\"s\":\"\\ud83d\\u0041\"}"));
+    TEST_CHECK(!test_stream("{\"s\":\"\\ude00\"}"));
+}
+
+// 超过maxDepth层的嵌套被拒绝，不会耗尽栈
+static void test_depth()
+{
+    for (size_t nDepth = JsonReader::maxDepth - 2; nDepth <= JsonReader::maxDepth + 2; ++nDepth)
+    {
+        std::string str = "{\"unknown\":";
+        str.append(nDepth, '[');
+        str.append(nDepth, ']');
+        str += "}";
+
+        // 外层对象占一层
+        bool bExpect = (nDepth + 1 <= size_t(JsonReader::maxDepth));
+        TEST_CHECK(test_stream(str.c_str()) == bExpect);
+        TEST_CHECK(test_dom(str.c_str()) == bExpect);
+    }
+
+    std::string str = "{\"unknown\":";
+    str.append(100000, '[');
+    TEST_CHECK(!test_stream(str.c_str()));
+    TEST_CHECK(!test_dom(str.c_str()));
+}
+
+// 数值超出字段类型的范围时读取失败
+static void test_range()
+{
+    TEST_CHECK(test_stream("{\"i32\":2147483647}"));
+    TEST_CHECK(test_stream("{\"i32\":-2147483648}"));
+    TEST_CHECK(!test_stream("{\"i32\":2147483648}"));
+    TEST_CHECK(!test_stream("{\"i32\":-2147483649}"));
+    TEST_CHECK(test_stream("{\"u32\":4294967295}"));
+    TEST_CHECK(!test_stream("{\"u32\":4294967296}"));
+    TEST_CHECK(!test_stream("{\"u32\":-1}"));
+    TEST_CHECK(test_stream("{\"i64\":-9223372036854775808}"));
+    TEST_CHECK(!test_stream("{\"i64\":9223372036854775808}"));
+    TEST_CHECK(test_stream("{\"u64\":18446744073709551615}"));
+    TEST_CHECK(!test_stream("{\"u64\":18446744073709551616}"));
+    TEST_CHECK(!test_stream("{\"u64\":100000000000000000000}"));
+    TEST_CHECK(test_stream("{\"f\":3.4028234663852886e+38}"));
+    TEST_CHECK(!test_stream("{\"f\":3.5e+38}"));
+    TEST_CHECK(!test_stream("{\"d\":1e400}"));
+
+    SStream obj;
+    TEST_CHECK(Json2Object(std::string("{\"i32\":1.9,\"u64\":1e3}"), obj));
+    TEST_CHECK(obj.i32 == 1 && obj.u64 == 1000);
+}
+
+// 默认路径读取为Json::Value，数值类型与Json::Reader一致
+static void test_dom_numbers()
+{
+    SDom obj;
+    TEST_CHECK(Json2Object(std::string("{\"a\":100000000000000000000,\"b\":-0,\"c\":-9223372036854775809,"
+                                       "\"d\":18446744073709551615,\"e\":-5,\"f\":0.25}"), obj));
+    TEST_CHECK(obj.js["a"].isDouble() && obj.js["a"].asDouble() == 1e20);
+    TEST_CHECK(obj.js["b"].isDouble() && obj.js["b"].asDouble() == 0 && signbit(obj.js["b"].asDouble()));
+    TEST_CHECK(obj.js["c"].isDouble() && obj.js["c"].asDouble() == -9223372036854775808.0);
+    TEST_CHECK(obj.js["d"].isUInt64() && obj.js["d"].asUInt64() == 18446744073709551615ull);
+    TEST_CHECK(obj.js["e"].isInt() && obj.js["e"].asInt() == -5);
+    TEST_CHECK(obj.js["f"].isDouble() && obj.js["f"].asDouble() == 0.25);
+}
+
+// 流式输出后分别以流式与Json::Value方式读回，结果都与原对象相同
+static void test_roundtrip()
+{
+    SStream obj;
+    obj.i32 = -123456; obj.u32 = 4000000000u;
+    obj.i64 = -9223372036854775807ll - 1; obj.u64 = 18446744073709551615ull;
+    obj.f = 3.14159f; obj.d = 1.0 / 3; obj.b = true;
+    obj.s = std::string("quote\" back\\ ctrl\x01\x1f tab\t \xe4\xb8\xad", 25);
+    for (int i = -50; i < 50; ++i)
+        obj.vec.push_back(i * 7919);
+    obj.m["k1"] = "v1";
+    obj.m[""] = "empty";
+
+    std::string strStream;
+    Object2Json(obj, strStream);
+
+    SStream o1;
+    TEST_CHECK(Json2Object(strStream, o1));
+    TEST_CHECK(o1 == obj);
+
+    Json::Value js;
+    Json::Reader reader;
+    TEST_CHECK(reader.parse(strStream, js));
+    SStream o2;
+    js >> o2;
+    TEST_CHECK(o2 == obj);
+
+    // Json::Value方式输出的文本经流式读取
+    Json::Value jsOut;
+    jsOut << obj;
+    Json::FastWriter writer;
+    SStream o3;
+    TEST_CHECK(Json2Object(writer.write(jsOut), o3));
+    TEST_CHECK(o3 == obj);
+
+    // 默认路径读取同一文本
+    SDom dom;
+    TEST_CHECK(Json2Object(strStream, dom));
+    TEST_CHECK(dom.js == js);
+}
+
+int main()
+{
+    test_grammar();
+    test_unicode();
+    test_depth();
+    test_range();
+    test_dom_numbers();
+    test_roundtrip();
+
+    if (g_nFailed != 0)
+    {
+        printf("%d check(s) failed\n", g_nFailed);
+        return 1;
+    }
+
+    printf("all passed\n");
+    return 0;
+}